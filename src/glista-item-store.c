@@ -0,0 +1,1438 @@
+/**
+ * Glista - A simple task list management utility
+ * Copyright (C) 2008 Shahar Evron, shahar@prematureoptimization.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <glib.h>
+#include <gtk/gtk.h>
+#include "glista.h"
+#include "glista-item-store.h"
+
+/**
+ * Glista Item Store
+ *
+ * The data model of the list. Rows are structs holding the values of all
+ * columns, kept in arrays: one for the root level, and one for the items of
+ * each category. Iterators point right at the rows, so getting from an
+ * iterator to a row takes no lookup, and the row knows its index among its
+ * siblings, so moving to the next row is a single array access. Rows can be
+ * read with GLISTA_ITEM_STORE_ROW() without copying any of their values.
+ *
+ * The store implements its own drag-and-drop rules. Categories can not be
+ * dragged, items can only be dropped on the root level or into a category,
+ * and empty categories are removed once their last item is dragged out of
+ * them.
+ */
+
+static void glista_item_store_tree_model_init(GtkTreeModelIface *iface);
+static void glista_item_store_sortable_init(GtkTreeSortableIface *iface);
+static void glista_item_store_drag_source_init(GtkTreeDragSourceIface *iface);
+static void glista_item_store_drag_dest_init(GtkTreeDragDestIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE(GlistaItemStore, glista_item_store, G_TYPE_OBJECT,
+                        G_IMPLEMENT_INTERFACE(GTK_TYPE_TREE_MODEL,
+                                          glista_item_store_tree_model_init)
+                        G_IMPLEMENT_INTERFACE(GTK_TYPE_TREE_SORTABLE,
+                                          glista_item_store_sortable_init)
+                        G_IMPLEMENT_INTERFACE(GTK_TYPE_TREE_DRAG_SOURCE,
+                                          glista_item_store_drag_source_init)
+                        G_IMPLEMENT_INTERFACE(GTK_TYPE_TREE_DRAG_DEST,
+                                          glista_item_store_drag_dest_init))
+
+/**
+ * Column types, in the order of GlistaColumn
+ */
+static const GType column_types[GL_N_COLUMNS] = {
+	G_TYPE_BOOLEAN, // Done?
+	G_TYPE_STRING,  // Text
+	G_TYPE_BOOLEAN, // Category?
+	G_TYPE_STRING,  // Note
+	G_TYPE_POINTER, // Reminder
+	G_TYPE_UINT64,  // Content hash as of last change
+	G_TYPE_UINT,    // Number of done items in a category
+	G_TYPE_UINT,    // Number of items in a category
+	G_TYPE_STRING,  // Sort key
+	G_TYPE_UINT64   // Item ID
+};
+
+/**
+ * glista_item_store_siblings:
+ * @store: The item store
+ * @row:   A row in the store
+ *
+ * Get the array holding a row and its siblings
+ *
+ * Returns: The rows on the same level as @row
+ */
+static GPtrArray*
+glista_item_store_siblings(GlistaItemStore *store, GlistaItemRow *row)
+{
+	return (row->parent != NULL ? row->parent->children : store->rows);
+}
+
+/**
+ * glista_item_store_iter_set:
+ * @store: The item store
+ * @iter:  The iterator to set
+ * @row:   The row to point to
+ *
+ * Point an iterator to a row
+ */
+static void
+glista_item_store_iter_set(GlistaItemStore *store, GtkTreeIter *iter,
+                           GlistaItemRow *row)
+{
+	iter->stamp      = store->stamp;
+	iter->user_data  = row;
+	iter->user_data2 = NULL;
+	iter->user_data3 = NULL;
+}
+
+/**
+ * glista_item_store_reindex:
+ * @rows: Array of sibling rows
+ * @from: Index of the first row to update
+ *
+ * Update the index of each row from @from to the end of @rows, after rows
+ * were inserted or removed
+ */
+static void
+glista_item_store_reindex(GPtrArray *rows, guint from)
+{
+	for (; from < rows->len; from++) {
+		((GlistaItemRow *) g_ptr_array_index(rows, from))->index = from;
+	}
+}
+
+/**
+ * glista_item_store_row_free:
+ * @row: The row to free
+ *
+ * Free a row, and the rows under it. Reminders are not owned by the store,
+ * and are left as they are.
+ */
+static void
+glista_item_store_row_free(GlistaItemRow *row)
+{
+	guint i;
+	
+	if (row->children != NULL) {
+		for (i = 0; i < row->children->len; i++) {
+			glista_item_store_row_free(g_ptr_array_index(row->children, i));
+		}
+		g_ptr_array_free(row->children, TRUE);
+	}
+	
+	g_free(row->text);
+	g_free(row->note);
+	g_free(row->sort_key);
+	g_slice_free(GlistaItemRow, row);
+}
+
+/**
+ * glista_item_store_get_flags:
+ * @model: The item store
+ *
+ * Iterators of the item store stay valid for as long as their row exists
+ *
+ * Returns: The model flags
+ */
+static GtkTreeModelFlags
+glista_item_store_get_flags(GtkTreeModel *model)
+{
+	return GTK_TREE_MODEL_ITERS_PERSIST;
+}
+
+/**
+ * glista_item_store_get_n_columns:
+ * @model: The item store
+ *
+ * Returns: The number of columns in the store
+ */
+static gint
+glista_item_store_get_n_columns(GtkTreeModel *model)
+{
+	return GL_N_COLUMNS;
+}
+
+/**
+ * glista_item_store_get_column_type:
+ * @model:  The item store
+ * @column: The column number
+ *
+ * Returns: The type of the column
+ */
+static GType
+glista_item_store_get_column_type(GtkTreeModel *model, gint column)
+{
+	g_return_val_if_fail(column >= 0 && column < GL_N_COLUMNS,
+	                     G_TYPE_INVALID);
+	
+	return column_types[column];
+}
+
+/**
+ * glista_item_store_get_iter:
+ * @model: The item store
+ * @iter:  The iterator to set
+ * @path:  The path of the row
+ *
+ * Point an iterator to the row at @path
+ *
+ * Returns: TRUE if @iter was set, FALSE if there is no such row
+ */
+static gboolean
+glista_item_store_get_iter(GtkTreeModel *model, GtkTreeIter *iter,
+                           GtkTreePath *path)
+{
+	GlistaItemStore *store = GLISTA_ITEM_STORE(model);
+	GlistaItemRow   *row = NULL;
+	GPtrArray       *rows;
+	gint            *indices;
+	gint             depth, i;
+	
+	indices = gtk_tree_path_get_indices(path);
+	depth   = gtk_tree_path_get_depth(path);
+	rows    = store->rows;
+	
+	for (i = 0; i < depth; i++) {
+		if (rows == NULL || indices[i] < 0 ||
+		    (guint) indices[i] >= rows->len) {
+			return FALSE;
+		}
+	
+		row  = g_ptr_array_index(rows, indices[i]);
+		rows = row->children;
+	}
+	
+	if (row == NULL) return FALSE;
+	
+	glista_item_store_iter_set(store, iter, row);
+	return TRUE;
+}
+
+/**
+ * glista_item_store_get_path:
+ * @model: The item store
+ * @iter:  Iterator pointing to a row
+ *
+ * Returns: A newly allocated path of the row
+ */
+static GtkTreePath*
+glista_item_store_get_path(GtkTreeModel *model, GtkTreeIter *iter)
+{
+	GtkTreePath   *path;
+	GlistaItemRow *row;
+	
+	g_return_val_if_fail(iter->stamp == GLISTA_ITEM_STORE(model)->stamp,
+	                     NULL);
+	
+	path = gtk_tree_path_new();
+	for (row = GLISTA_ITEM_STORE_ROW(iter); row != NULL; row = row->parent) {
+		gtk_tree_path_prepend_index(path, row->index);
+	}
+	
+	return path;
+}
+
+/**
+ * glista_item_store_get_value:
+ * @model:  The item store
+ * @iter:   Iterator pointing to a row
+ * @column: The column to get
+ * @value:  An empty GValue to set
+ *
+ * Get the value of a column, for gtk_tree_model_get() and friends
+ */
+static void
+glista_item_store_get_value(GtkTreeModel *model, GtkTreeIter *iter,
+                            gint column, GValue *value)
+{
+	GlistaItemRow *row;
+	
+	g_return_if_fail(column >= 0 && column < GL_N_COLUMNS);
+	g_return_if_fail(iter->stamp == GLISTA_ITEM_STORE(model)->stamp);
+	
+	row = GLISTA_ITEM_STORE_ROW(iter);
+	g_value_init(value, column_types[column]);
+	
+	switch (column) {
+		case GL_COLUMN_DONE:
+			g_value_set_boolean(value, row->done);
+			break;
+	
+		case GL_COLUMN_TEXT:
+			g_value_set_string(value, row->text);
+			break;
+	
+		case GL_COLUMN_CATEGORY:
+			g_value_set_boolean(value, row->category);
+			break;
+	
+		case GL_COLUMN_NOTE:
+			g_value_set_string(value, row->note);
+			break;
+	
+		case GL_COLUMN_REMINDER:
+			g_value_set_pointer(value, row->reminder);
+			break;
+	
+		case GL_COLUMN_HASH:
+			g_value_set_uint64(value, row->hash);
+			break;
+	
+		case GL_COLUMN_DONE_COUNT:
+			g_value_set_uint(value, row->done_count);
+			break;
+	
+		case GL_COLUMN_TOTAL_COUNT:
+			g_value_set_uint(value, row->total_count);
+			break;
+	
+		case GL_COLUMN_SORT_KEY:
+			g_value_set_string(value, row->sort_key);
+			break;
+	
+		case GL_COLUMN_ID:
+			g_value_set_uint64(value, row->id);
+			break;
+	}
+}
+
+/**
+ * glista_item_store_iter_next:
+ * @model: The item store
+ * @iter:  Iterator to move to the next row on the same level
+ *
+ * Returns: TRUE if @iter was moved, FALSE if there is no next row
+ */
+static gboolean
+glista_item_store_iter_next(GtkTreeModel *model, GtkTreeIter *iter)
+{
+	GlistaItemRow *row;
+	GPtrArray     *rows;
+	
+	row  = GLISTA_ITEM_STORE_ROW(iter);
+	rows = glista_item_store_siblings(GLISTA_ITEM_STORE(model), row);
+	
+	if (row->index + 1 >= rows->len) {
+		iter->stamp = 0;
+		return FALSE;
+	}
+	
+	iter->user_data = g_ptr_array_index(rows, row->index + 1);
+	return TRUE;
+}
+
+/**
+ * glista_item_store_iter_nth_child:
+ * @model:  The item store
+ * @iter:   The iterator to set
+ * @parent: The parent row, or NULL for the root level
+ * @n:      Index of the child row
+ *
+ * Returns: TRUE if @iter was set, FALSE if there is no such row
+ */
+static gboolean
+glista_item_store_iter_nth_child(GtkTreeModel *model, GtkTreeIter *iter,
+                                 GtkTreeIter *parent, gint n)
+{
+	GlistaItemStore *store = GLISTA_ITEM_STORE(model);
+	GPtrArray       *rows;
+	
+	rows = (parent == NULL ? store->rows :
+	                         GLISTA_ITEM_STORE_ROW(parent)->children);
+	
+	if (rows == NULL || n < 0 || (guint) n >= rows->len) {
+		return FALSE;
+	}
+	
+	glista_item_store_iter_set(store, iter, g_ptr_array_index(rows, n));
+	return TRUE;
+}
+
+/**
+ * glista_item_store_iter_children:
+ * @model:  The item store
+ * @iter:   The iterator to set
+ * @parent: The parent row, or NULL for the root level
+ *
+ * Returns: TRUE if @iter was set to the first child row, FALSE otherwise
+ */
+static gboolean
+glista_item_store_iter_children(GtkTreeModel *model, GtkTreeIter *iter,
+                                GtkTreeIter *parent)
+{
+	return glista_item_store_iter_nth_child(model, iter, parent, 0);
+}
+
+/**
+ * glista_item_store_iter_n_children:
+ * @model: The item store
+ * @iter:  The parent row, or NULL for the root level
+ *
+ * Returns: The number of child rows
+ */
+static gint
+glista_item_store_iter_n_children(GtkTreeModel *model, GtkTreeIter *iter)
+{
+	GPtrArray *rows;
+	
+	rows = (iter == NULL ? GLISTA_ITEM_STORE(model)->rows :
+	                       GLISTA_ITEM_STORE_ROW(iter)->children);
+	
+	return (rows == NULL ? 0 : rows->len);
+}
+
+/**
+ * glista_item_store_iter_has_child:
+ * @model: The item store
+ * @iter:  Iterator pointing to a row
+ *
+ * Returns: TRUE if the row has child rows, FALSE otherwise
+ */
+static gboolean
+glista_item_store_iter_has_child(GtkTreeModel *model, GtkTreeIter *iter)
+{
+	return (glista_item_store_iter_n_children(model, iter) > 0);
+}
+
+/**
+ * glista_item_store_iter_parent:
+ * @model: The item store
+ * @iter:  The iterator to set
+ * @child: Iterator pointing to a row
+ *
+ * Returns: TRUE if @iter was set to the parent row, FALSE if there is none
+ */
+static gboolean
+glista_item_store_iter_parent(GtkTreeModel *model, GtkTreeIter *iter,
+                              GtkTreeIter *child)
+{
+	GlistaItemRow *parent;
+	
+	if ((parent = GLISTA_ITEM_STORE_ROW(child)->parent) == NULL) {
+		return FALSE;
+	}
+	
+	glista_item_store_iter_set(GLISTA_ITEM_STORE(model), iter, parent);
+	return TRUE;
+}
+
+/**
+ * glista_item_store_is_sorted:
+ * @store: The item store
+ *
+ * Returns: TRUE if the store keeps its rows sorted, FALSE otherwise
+ */
+static gboolean
+glista_item_store_is_sorted(GlistaItemStore *store)
+{
+	if (store->sort_column == GTK_TREE_SORTABLE_DEFAULT_SORT_COLUMN_ID) {
+		return (store->default_func != NULL);
+	}
+	
+	return (store->sort_column != GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID &&
+	        store->sort_column == store->func_column &&
+	        store->sort_func != NULL);
+}
+
+/**
+ * glista_item_store_compare:
+ * @store: The item store
+ * @a:     First row to compare
+ * @b:     Second row to compare
+ *
+ * Compare two rows using the sort function of the current sort column. Must
+ * only be called if the store is sorted.
+ *
+ * Returns: Negative if @a sorts before @b, positive if after, 0 if equal
+ */
+static gint
+glista_item_store_compare(GlistaItemStore *store, GlistaItemRow *a,
+                          GlistaItemRow *b)
+{
+	GtkTreeIter iter_a, iter_b;
+	gint        ret;
+	
+	glista_item_store_iter_set(store, &iter_a, a);
+	glista_item_store_iter_set(store, &iter_b, b);
+	
+	if (store->sort_column == GTK_TREE_SORTABLE_DEFAULT_SORT_COLUMN_ID) {
+		ret = store->default_func(GTK_TREE_MODEL(store), &iter_a, &iter_b,
+		                          store->default_data);
+	} else {
+		ret = store->sort_func(GTK_TREE_MODEL(store), &iter_a, &iter_b,
+		                       store->sort_data);
+	}
+	
+	return (store->sort_order == GTK_SORT_DESCENDING ? -ret : ret);
+}
+
+/**
+ * glista_item_store_compare_cb:
+ * @a:     Pointer to the first row to compare
+ * @b:     Pointer to the second row to compare
+ * @store: The item store
+ *
+ * GCompareDataFunc comparing two rows in an array of rows
+ *
+ * Returns: See glista_item_store_compare()
+ */
+static gint
+glista_item_store_compare_cb(gconstpointer a, gconstpointer b, gpointer store)
+{
+	return glista_item_store_compare(GLISTA_ITEM_STORE(store),
+	                                 *((GlistaItemRow **) a),
+	                                 *((GlistaItemRow **) b));
+}
+
+/**
+ * glista_item_store_reordered:
+ * @store:  The item store
+ * @parent: The row whose children were reordered, or NULL for the root level
+ * @rows:   The reordered rows, still holding their old indexes
+ *
+ * Update the indexes of reordered rows, and emit "rows-reordered"
+ */
+static void
+glista_item_store_reordered(GlistaItemStore *store, GlistaItemRow *parent,
+                            GPtrArray *rows)
+{
+	GlistaItemRow *row;
+	GtkTreePath   *path;
+	GtkTreeIter    iter;
+	gint          *new_order;
+	guint          i;
+	
+	new_order = g_new(gint, rows->len);
+	for (i = 0; i < rows->len; i++) {
+		row = g_ptr_array_index(rows, i);
+		new_order[i] = row->index;
+		row->index = i;
+	}
+	
+	if (parent != NULL) {
+		glista_item_store_iter_set(store, &iter, parent);
+		path = glista_item_store_get_path(GTK_TREE_MODEL(store), &iter);
+		gtk_tree_model_rows_reordered(GTK_TREE_MODEL(store), path, &iter,
+		                              new_order);
+	} else {
+		path = gtk_tree_path_new();
+		gtk_tree_model_rows_reordered(GTK_TREE_MODEL(store), path, NULL,
+		                              new_order);
+	}
+	
+	gtk_tree_path_free(path);
+	g_free(new_order);
+}
+
+/**
+ * glista_item_store_sort_level:
+ * @store:  The item store
+ * @parent: The row whose children to sort, or NULL for the root level
+ *
+ * Sort a level of the store, and the levels under it
+ */
+static void
+glista_item_store_sort_level(GlistaItemStore *store, GlistaItemRow *parent)
+{
+	GPtrArray     *rows;
+	GlistaItemRow *row;
+	guint          i;
+	
+	rows = (parent == NULL ? store->rows : parent->children);
+	if (rows == NULL || rows->len == 0) return;
+	
+	if (rows->len > 1) {
+		g_qsort_with_data(rows->pdata, rows->len, sizeof(gpointer),
+		                  glista_item_store_compare_cb, store);
+		glista_item_store_reordered(store, parent, rows);
+	}
+	
+	for (i = 0; i < rows->len; i++) {
+		row = g_ptr_array_index(rows, i);
+		if (row->children != NULL) {
+			glista_item_store_sort_level(store, row);
+		}
+	}
+}
+
+/**
+ * glista_item_store_sort_row:
+ * @store: The item store
+ * @row:   A row which was changed
+ *
+ * Move a changed row to its sorted place. All other rows on the same level
+ * are sorted already, so the new place is found with a binary search.
+ */
+static void
+glista_item_store_sort_row(GlistaItemStore *store, GlistaItemRow *row)
+{
+	GPtrArray *rows;
+	gpointer  *pdata;
+	guint      old_index, new_index, low, high, mid;
+	
+	rows      = glista_item_store_siblings(store, row);
+	pdata     = rows->pdata;
+	old_index = row->index;
+	
+	// Leave the row where it is if it is still in order
+	if ((old_index == 0 ||
+	     glista_item_store_compare(store, pdata[old_index - 1], row) <= 0) &&
+	    (old_index + 1 >= rows->len ||
+	     glista_item_store_compare(store, row, pdata[old_index + 1]) <= 0)) {
+		return;
+	}
+	
+	// Search the other rows, skipping the row itself
+	low  = 0;
+	high = rows->len - 1;
+	while (low < high) {
+		mid = (low + high) / 2;
+		if (glista_item_store_compare(store,
+		        pdata[mid < old_index ? mid : mid + 1], row) <= 0) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+	new_index = low;
+	
+	if (new_index < old_index) {
+		memmove(pdata + new_index + 1, pdata + new_index,
+		        (old_index - new_index) * sizeof(gpointer));
+	} else {
+		memmove(pdata + old_index, pdata + old_index + 1,
+		        (new_index - old_index) * sizeof(gpointer));
+	}
+	pdata[new_index] = row;
+	
+	glista_item_store_reordered(store, row->parent, rows);
+}
+
+/**
+ * glista_item_store_insert_row:
+ * @store:    The item store
+ * @parent:   The category to insert the row into, or NULL for the root level
+ * @position: Index to insert the row at, or -1 to append it
+ * @row:      The row to insert
+ * @iter:     Iterator to point to the inserted row
+ *
+ * Insert a row into the store, and emit "row-inserted". Rows are inserted
+ * where they are asked to, even if the store is sorted.
+ */
+static void
+glista_item_store_insert_row(GlistaItemStore *store, GlistaItemRow *parent,
+                             gint position, GlistaItemRow *row,
+                             GtkTreeIter *iter)
+{
+	GtkTreeModel *model = GTK_TREE_MODEL(store);
+	GtkTreePath  *path;
+	GtkTreeIter   parent_iter;
+	GPtrArray    *rows;
+	
+	if (parent != NULL) {
+		if (parent->children == NULL) {
+			parent->children = g_ptr_array_new();
+		}
+		rows = parent->children;
+	} else {
+		rows = store->rows;
+	}
+	
+	if (position < 0 || (guint) position > rows->len) {
+		position = rows->len;
+	}
+	
+	// Make room for the row
+	g_ptr_array_add(rows, row);
+	memmove(rows->pdata + position + 1, rows->pdata + position,
+	        (rows->len - position - 1) * sizeof(gpointer));
+	rows->pdata[position] = row;
+	
+	row->parent = parent;
+	glista_item_store_reindex(rows, position);
+	
+	glista_item_store_iter_set(store, iter, row);
+	path = glista_item_store_get_path(model, iter);
+	gtk_tree_model_row_inserted(model, path, iter);
+	
+	if (parent != NULL && rows->len == 1) {
+		gtk_tree_path_up(path);
+		glista_item_store_iter_set(store, &parent_iter, parent);
+		gtk_tree_model_row_has_child_toggled(model, path, &parent_iter);
+	}
+	
+	gtk_tree_path_free(path);
+}
+
+/**
+ * glista_item_store_row_changed:
+ * @store: The item store
+ * @iter:  Iterator pointing to a changed row
+ *
+ * Move a changed row to its sorted place if the store is sorted, and emit
+ * "row-changed"
+ */
+static void
+glista_item_store_row_changed(GlistaItemStore *store, GtkTreeIter *iter)
+{
+	GtkTreePath *path;
+	
+	if (glista_item_store_is_sorted(store)) {
+		glista_item_store_sort_row(store, GLISTA_ITEM_STORE_ROW(iter));
+	}
+	
+	path = glista_item_store_get_path(GTK_TREE_MODEL(store), iter);
+	gtk_tree_model_row_changed(GTK_TREE_MODEL(store), path, iter);
+	gtk_tree_path_free(path);
+}
+
+/**
+ * glista_item_store_set_string:
+ * @field: The string field of a row to set
+ * @value: The string to copy into the field, may be NULL
+ *
+ * Replace a string value of a row. @value may point to the current value.
+ */
+static void
+glista_item_store_set_string(gchar **field, const gchar *value)
+{
+	gchar *copy;
+	
+	copy = g_strdup(value);
+	g_free(*field);
+	*field = copy;
+}
+
+/**
+ * glista_item_store_append:
+ * @store:  The item store
+ * @iter:   Iterator to point to the new row
+ * @parent: The category to append the row to, or NULL for the root level
+ *
+ * Append a new, empty row. As with GtkTreeStore, the row is appended even
+ * if the store is sorted, and moves to its sorted place once it is set.
+ */
+void
+glista_item_store_append(GlistaItemStore *store, GtkTreeIter *iter,
+                         GtkTreeIter *parent)
+{
+	g_return_if_fail(GLISTA_IS_ITEM_STORE(store));
+	
+	glista_item_store_insert_row(store,
+	                             (parent != NULL ?
+	                              GLISTA_ITEM_STORE_ROW(parent) : NULL),
+	                             -1, g_slice_new0(GlistaItemRow), iter);
+}
+
+/**
+ * glista_item_store_remove:
+ * @store: The item store
+ * @iter:  Iterator pointing to the row to remove
+ *
+ * Remove a row, and the rows under it, and emit "row-deleted". @iter is no
+ * longer valid once the row is removed.
+ */
+void
+glista_item_store_remove(GlistaItemStore *store, GtkTreeIter *iter)
+{
+	GtkTreeModel  *model = GTK_TREE_MODEL(store);
+	GtkTreePath   *path;
+	GtkTreeIter    parent_iter;
+	GlistaItemRow *row, *parent;
+	GPtrArray     *rows;
+	
+	g_return_if_fail(GLISTA_IS_ITEM_STORE(store));
+	g_return_if_fail(iter->stamp == store->stamp);
+	
+	row    = GLISTA_ITEM_STORE_ROW(iter);
+	parent = row->parent;
+	rows   = glista_item_store_siblings(store, row);
+	path   = glista_item_store_get_path(model, iter);
+	
+	g_ptr_array_remove_index(rows, row->index);
+	glista_item_store_reindex(rows, row->index);
+	glista_item_store_row_free(row);
+	iter->stamp = 0;
+	
+	gtk_tree_model_row_deleted(model, path);
+	
+	if (parent != NULL && rows->len == 0) {
+		gtk_tree_path_up(path);
+		glista_item_store_iter_set(store, &parent_iter, parent);
+		gtk_tree_model_row_has_child_toggled(model, path, &parent_iter);
+	}
+	
+	gtk_tree_path_free(path);
+}
+
+/**
+ * glista_item_store_remove_rows:
+ * @store: The item store
+ * @iters: List of iterators pointing to the rows to remove
+ *
+ * Remove several rows at once, along with the rows under them. Each level is
+ * compacted in a single pass and reindexed once, instead of once per row. 
+ * "row-deleted" is then emitted for each removed row, from the last row up, 
+ * so that each path is still valid when it is emitted. Rows under a removed 
+ * category go away with it. The iterators are no longer valid once the rows
+ * are removed.
+ */
+void
+glista_item_store_remove_rows(GlistaItemStore *store, GList *iters)
+{
+	GtkTreeModel  *model = GTK_TREE_MODEL(store);
+	GHashTable    *removed, *levels;
+	GHashTableIter level_iter;
+	GList         *paths = NULL, *node;
+	GtkTreeIter   *iter, parent_iter;
+	GtkTreePath   *path;
+	GlistaItemRow *row, *ancestor, *parent;
+	GPtrArray     *rows;
+	guint          i, kept, first;
+	
+	g_return_if_fail(GLISTA_IS_ITEM_STORE(store));
+	
+	for (node = iters; node != NULL; node = node->next) {
+		g_return_if_fail(((GtkTreeIter *) node->data)->stamp == store->stamp);
+	}
+	
+	removed = g_hash_table_new(g_direct_hash, g_direct_equal);
+	levels  = g_hash_table_new(g_direct_hash, g_direct_equal);
+	
+	for (node = iters; node != NULL; node = node->next) {
+		row = GLISTA_ITEM_STORE_ROW((GtkTreeIter *) node->data);
+		g_hash_table_insert(removed, row, row);
+	}
+	
+	// Find the levels to compact, and the paths of the rows to remove while
+	// they are still valid
+	for (node = iters; node != NULL; node = node->next) {
+		iter = (GtkTreeIter *) node->data;
+		row  = GLISTA_ITEM_STORE_ROW(iter);
+		
+		for (ancestor = row->parent; ancestor != NULL; 
+		     ancestor = ancestor->parent) {
+			if (g_hash_table_lookup(removed, ancestor) != NULL) break;
+		}
+		
+		if (ancestor == NULL) {
+			paths = g_list_prepend(paths, 
+			                       glista_item_store_get_path(model, iter));
+			g_hash_table_insert(levels, glista_item_store_siblings(store, row),
+			                    row->parent);
+		}
+		
+		iter->stamp = 0;
+	}
+	
+	// Compact each level in a single pass
+	g_hash_table_iter_init(&level_iter, levels);
+	while (g_hash_table_iter_next(&level_iter, (gpointer *) &rows, NULL)) {
+		first = rows->len;
+		kept  = 0;
+		
+		for (i = 0; i < rows->len; i++) {
+			row = g_ptr_array_index(rows, i);
+			if (g_hash_table_lookup(removed, row) != NULL) {
+				if (first == rows->len) first = i;
+				glista_item_store_row_free(row);
+			} else {
+				rows->pdata[kept++] = row;
+			}
+		}
+		
+		g_ptr_array_set_size(rows, kept);
+		glista_item_store_reindex(rows, first);
+	}
+	
+	// Emit "row-deleted" from the last row up
+	paths = g_list_sort(paths, (GCompareFunc) gtk_tree_path_compare);
+	paths = g_list_reverse(paths);
+	for (node = paths; node != NULL; node = node->next) {
+		gtk_tree_model_row_deleted(model, (GtkTreePath *) node->data);
+		gtk_tree_path_free((GtkTreePath *) node->data);
+	}
+	g_list_free(paths);
+	
+	// Let the view know about categories left with no rows
+	g_hash_table_iter_init(&level_iter, levels);
+	while (g_hash_table_iter_next(&level_iter, (gpointer *) &rows, 
+	                              (gpointer *) &parent)) {
+		if (parent != NULL && rows->len == 0) {
+			glista_item_store_iter_set(store, &parent_iter, parent);
+			path = glista_item_store_get_path(model, &parent_iter);
+			gtk_tree_model_row_has_child_toggled(model, path, &parent_iter);
+			gtk_tree_path_free(path);
+		}
+	}
+	
+	g_hash_table_destroy(levels);
+	g_hash_table_destroy(removed);
+}
+
+/**
+ * glista_item_store_set:
+ * @store: The item store
+ * @iter:  Iterator pointing to the row to set
+ * @...:   Pairs of column number and value, terminated by -1
+ *
+ * Set values in a row, as gtk_tree_store_set() does. Strings are copied.
+ * The row is moved to its sorted place if the store is sorted, and
+ * "row-changed" is emitted once all values are set.
+ */
+void
+glista_item_store_set(GlistaItemStore *store, GtkTreeIter *iter, ...)
+{
+	GlistaItemRow *row;
+	va_list        args;
+	gint           column;
+	
+	g_return_if_fail(GLISTA_IS_ITEM_STORE(store));
+	g_return_if_fail(iter->stamp == store->stamp);
+	
+	row = GLISTA_ITEM_STORE_ROW(iter);
+	va_start(args, iter);
+	
+	while ((column = va_arg(args, gint)) != -1) {
+		switch (column) {
+			case GL_COLUMN_DONE:
+				row->done = va_arg(args, gboolean);
+				break;
+	
+			case GL_COLUMN_TEXT:
+				glista_item_store_set_string(&row->text,
+				                             va_arg(args, const gchar *));
+				break;
+	
+			case GL_COLUMN_CATEGORY:
+				row->category = va_arg(args, gboolean);
+				break;
+	
+			case GL_COLUMN_NOTE:
+				glista_item_store_set_string(&row->note,
+				                             va_arg(args, const gchar *));
+				break;
+	
+			case GL_COLUMN_REMINDER:
+				row->reminder = va_arg(args, gpointer);
+				break;
+	
+			case GL_COLUMN_HASH:
+				row->hash = va_arg(args, guint64);
+				break;
+	
+			case GL_COLUMN_DONE_COUNT:
+				row->done_count = va_arg(args, guint);
+				break;
+	
+			case GL_COLUMN_TOTAL_COUNT:
+				row->total_count = va_arg(args, guint);
+				break;
+	
+			case GL_COLUMN_SORT_KEY:
+				glista_item_store_set_string(&row->sort_key,
+				                             va_arg(args, const gchar *));
+				break;
+	
+			case GL_COLUMN_ID:
+				row->id = va_arg(args, guint64);
+				break;
+	
+			default:
+				g_warning("Invalid item store column number %d", column);
+				va_end(args);
+				return;
+		}
+	}
+	
+	va_end(args);
+	
+	glista_item_store_row_changed(store, iter);
+}
+
+/**
+ * glista_item_store_get_sort_column_id:
+ * @sortable:       The item store
+ * @sort_column_id: Pointer to set to the current sort column ID, or NULL
+ * @order:          Pointer to set to the current sort order, or NULL
+ *
+ * Returns: TRUE if the sort column is not one of the special sort column IDs
+ */
+static gboolean
+glista_item_store_get_sort_column_id(GtkTreeSortable *sortable,
+                                     gint *sort_column_id,
+                                     GtkSortType *order)
+{
+	GlistaItemStore *store = GLISTA_ITEM_STORE(sortable);
+	
+	if (sort_column_id != NULL) *sort_column_id = store->sort_column;
+	if (order != NULL) *order = store->sort_order;
+	
+	return (store->sort_column != GTK_TREE_SORTABLE_DEFAULT_SORT_COLUMN_ID &&
+	        store->sort_column != GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID);
+}
+
+/**
+ * glista_item_store_set_sort_column_id:
+ * @sortable:       The item store
+ * @sort_column_id: The sort column ID to sort by
+ * @order:          The sort order
+ *
+ * Set the sort column, and sort the store. Rows keep their order if the
+ * store is set to be unsorted.
+ */
+static void
+glista_item_store_set_sort_column_id(GtkTreeSortable *sortable,
+                                     gint sort_column_id, GtkSortType order)
+{
+	GlistaItemStore *store = GLISTA_ITEM_STORE(sortable);
+	
+	if (store->sort_column == sort_column_id && store->sort_order == order) {
+		return;
+	}
+	
+	store->sort_column = sort_column_id;
+	store->sort_order  = order;
+	
+	gtk_tree_sortable_sort_column_changed(sortable);
+	
+	if (glista_item_store_is_sorted(store)) {
+		glista_item_store_sort_level(store, NULL);
+	}
+}
+
+/**
+ * glista_item_store_set_sort_func:
+ * @sortable:       The item store
+ * @sort_column_id: The sort column ID to set the function for
+ * @sort_func:      The sort function
+ * @user_data:      User data to pass to @sort_func
+ * @destroy:        Function to free @user_data, or NULL
+ *
+ * Set the function to sort by a sort column ID. The list is only ever sorted
+ * one way, so only one sort function is kept besides the default one:
+ * setting the function of another column replaces it.
+ */
+static void
+glista_item_store_set_sort_func(GtkTreeSortable *sortable,
+                                gint sort_column_id,
+                                GtkTreeIterCompareFunc sort_func,
+                                gpointer user_data, GDestroyNotify destroy)
+{
+	GlistaItemStore *store = GLISTA_ITEM_STORE(sortable);
+	
+	if (store->sort_destroy != NULL) {
+		store->sort_destroy(store->sort_data);
+	}
+	
+	store->func_column  = sort_column_id;
+	store->sort_func    = sort_func;
+	store->sort_data    = user_data;
+	store->sort_destroy = destroy;
+	
+	if (store->sort_column == sort_column_id &&
+	    glista_item_store_is_sorted(store)) {
+		glista_item_store_sort_level(store, NULL);
+	}
+}
+
+/**
+ * glista_item_store_set_default_sort_func:
+ * @sortable:  The item store
+ * @sort_func: The default sort function, or NULL
+ * @user_data: User data to pass to @sort_func
+ * @destroy:   Function to free @user_data, or NULL
+ *
+ * Set the function to sort by when sorting by the default sort column ID
+ */
+static void
+glista_item_store_set_default_sort_func(GtkTreeSortable *sortable,
+                                        GtkTreeIterCompareFunc sort_func,
+                                        gpointer user_data,
+                                        GDestroyNotify destroy)
+{
+	GlistaItemStore *store = GLISTA_ITEM_STORE(sortable);
+	
+	if (store->default_destroy != NULL) {
+		store->default_destroy(store->default_data);
+	}
+	
+	store->default_func    = sort_func;
+	store->default_data    = user_data;
+	store->default_destroy = destroy;
+	
+	if (store->sort_column == GTK_TREE_SORTABLE_DEFAULT_SORT_COLUMN_ID &&
+	    glista_item_store_is_sorted(store)) {
+		glista_item_store_sort_level(store, NULL);
+	}
+}
+
+/**
+ * glista_item_store_has_default_sort_func:
+ * @sortable: The item store
+ *
+ * Returns: TRUE if a default sort function is set, FALSE otherwise
+ */
+static gboolean
+glista_item_store_has_default_sort_func(GtkTreeSortable *sortable)
+{
+	return (GLISTA_ITEM_STORE(sortable)->default_func != NULL);
+}
+
+/**
+ * glista_item_store_row_draggable:
+ * @drag_source The drag source
+ * @path        The path in the tree of the dragged row
+ *
+ * Tells whether or not a row can be dragged. A row can be dragged if it is
+ * not a category. If row no longer exists will return FALSE.
+ *
+ * Returns: TRUE if row can be dragged, FALSE otherwise
+ */
+static gboolean
+glista_item_store_row_draggable(GtkTreeDragSource *drag_source,
+                                GtkTreePath *path)
+{
+	GtkTreeIter iter;
+	
+	if (gtk_tree_model_get_iter(GTK_TREE_MODEL(drag_source), &iter, path)) {
+		return (! GLISTA_ITEM_STORE_ROW(&iter)->category);
+	
+	} else {
+		return FALSE;
+	}
+}
+
+/**
+ * glista_item_store_drag_data_get:
+ * @drag_source:    The source of the drag operation
+ * @path:           The path of the dragged row
+ * @selection_data: The selection data to fill
+ *
+ * Fill in the selection data with the dragged row
+ *
+ * Returns: TRUE if the data was set, FALSE otherwise
+ */
+static gboolean
+glista_item_store_drag_data_get(GtkTreeDragSource *drag_source,
+                                GtkTreePath *path,
+                                GtkSelectionData *selection_data)
+{
+	return gtk_tree_set_row_drag_data(selection_data,
+	                                  GTK_TREE_MODEL(drag_source), path);
+}
+
+/**
+ * glista_item_store_drag_data_delete:
+ * @drag_source: The source of the drag operation
+ * @path:        The path to delete
+ *
+ * Deletes a row after it has been dragged to a new location. Will also check
+ * if parent category is now empty, and if so will delete it.
+ *
+ * Returns: TRUE if the deletion succeeded, FALSE otherwise.
+ */
+static gboolean
+glista_item_store_drag_data_delete(GtkTreeDragSource *drag_source,
+                                   GtkTreePath *path)
+{
+	GtkTreeModel *model = GTK_TREE_MODEL(drag_source);
+	GtkTreeIter   iter, parent;
+	gboolean      has_parent;
+	
+	if (gtk_tree_model_get_iter(model, &iter, path)) {
+		// Check if this item has a parent category
+		has_parent = gtk_tree_model_iter_parent(model, &parent, &iter);
+	
+		// Remove item. Its ID already points to the dropped copy.
+		glista_item_count_in_parent(&iter, -1);
+		glista_item_unindex(&iter);
+		glista_item_store_remove(GLISTA_ITEM_STORE(drag_source), &iter);
+	
+		// Check if parent is now empty
+		if (has_parent && gtk_tree_model_iter_n_children(model, &parent) < 1) {
+			// Delete parent as well
+			glista_category_delete(&parent);
+		}
+	
+		return TRUE;
+	
+	} else {
+		return FALSE;
+	}
+}
+
+/**
+ * glista_item_store_row_drop_possible:
+ * @drag_dest:      The drag destination
+ * @path:           The path in the tree to check
+ * @selection_data: The selected data
+ *
+ * Tells whether a drop is possible before @path, on the same level. Items can
+ * be dropped on the root level, or into a category.
+ *
+ * Returns: TRUE if a drop is possible, FALSE otherwise
+ */
+static gboolean
+glista_item_store_row_drop_possible(GtkTreeDragDest *drag_dest,
+                                    GtkTreePath *path,
+                                    GtkSelectionData *selection_data)
+{
+	GtkTreePath *parent;
+	GtkTreeIter  iter;
+	gint         depth;
+	gboolean     can_drop = TRUE;
+	
+	depth = gtk_tree_path_get_depth(path);
+	
+	// Can't create 3rd level or more
+	if (depth > 2) {
+		return FALSE;
+	}
+	
+	// Can always drop on root level
+	if (depth < 2) {
+		return TRUE;
+	}
+	
+	// If level is 2, we have to check that the parent is a category
+	parent = gtk_tree_path_copy(path);
+	if (gtk_tree_path_up(parent)) {
+		if (gtk_tree_model_get_iter(GTK_TREE_MODEL(drag_dest), &iter,
+		                            parent)) {
+			can_drop = GLISTA_ITEM_STORE_ROW(&iter)->category;
+		}
+	}
+	gtk_tree_path_free(parent);
+	
+	return can_drop;
+}
+
+/**
+ * glista_item_store_drag_data_received:
+ * @drag_dest:      The drag destination
+ * @path:           The path being dragged
+ * @selection_data: The selection data
+ *
+ * Insert a copy of the dropped row before @path, and point its ID to the new
+ * row. The copy keeps the content hash of the row, so it is only saved again
+ * if its category changed, once "row-changed" is emitted for it. It is then 
+ * moved to its sorted place.
+ *
+ * Returns: TRUE if the row was inserted, FALSE otherwise
+ */
+static gboolean
+glista_item_store_drag_data_received(GtkTreeDragDest *drag_dest,
+                                     GtkTreePath *path,
+                                     GtkSelectionData *selection_data)
+{
+	GlistaItemStore *store = GLISTA_ITEM_STORE(drag_dest);
+	GtkTreeModel    *src_model;
+	GtkTreePath     *src_path, *parent_path;
+	GtkTreeIter      src_iter, parent, iter;
+	GlistaItemRow   *src, *row, *parent_row = NULL;
+	gboolean         res = FALSE;
+	
+	if (! gtk_tree_get_row_drag_data(selection_data, &src_model, &src_path)) {
+		return FALSE;
+	}
+	
+	if (src_model == GTK_TREE_MODEL(store) &&
+	    gtk_tree_model_get_iter(src_model, &src_iter, src_path)) {
+	
+		// Find the category the row was dropped into, if any
+		parent_path = gtk_tree_path_copy(path);
+		res = TRUE;
+		if (gtk_tree_path_up(parent_path) &&
+		    gtk_tree_path_get_depth(parent_path) > 0) {
+	
+			if (gtk_tree_model_get_iter(src_model, &parent, parent_path)) {
+				parent_row = GLISTA_ITEM_STORE_ROW(&parent);
+			} else {
+				res = FALSE;
+			}
+		}
+		gtk_tree_path_free(parent_path);
+	
+		if (res) {
+			src = GLISTA_ITEM_STORE_ROW(&src_iter);
+			row = g_slice_new0(GlistaItemRow);
+	
+			row->done     = src->done;
+			row->text     = g_strdup(src->text);
+			row->note     = g_strdup(src->note);
+			row->reminder = src->reminder;
+			row->sort_key = g_strdup(src->sort_key);
+			row->hash     = src->hash;
+			row->id       = src->id;
+	
+			glista_item_store_insert_row(store, parent_row,
+				gtk_tree_path_get_indices(path)[
+					gtk_tree_path_get_depth(path) - 1], row, &iter);
+	
+			// Point the ID to the copy, so that its reminder follows it
+			glista_item_index(&iter);
+			
+			glista_item_store_row_changed(store, &iter);
+		}
+	}
+	
+	gtk_tree_path_free(src_path);
+	
+	return res;
+}
+
+/**
+ * glista_item_store_tree_model_init:
+ * @iface: The tree model interface
+ *
+ * Set up the tree model implementation
+ */
+static void
+glista_item_store_tree_model_init(GtkTreeModelIface *iface)
+{
+	iface->get_flags       = glista_item_store_get_flags;
+	iface->get_n_columns   = glista_item_store_get_n_columns;
+	iface->get_column_type = glista_item_store_get_column_type;
+	iface->get_iter        = glista_item_store_get_iter;
+	iface->get_path        = glista_item_store_get_path;
+	iface->get_value       = glista_item_store_get_value;
+	iface->iter_next       = glista_item_store_iter_next;
+	iface->iter_children   = glista_item_store_iter_children;
+	iface->iter_has_child  = glista_item_store_iter_has_child;
+	iface->iter_n_children = glista_item_store_iter_n_children;
+	iface->iter_nth_child  = glista_item_store_iter_nth_child;
+	iface->iter_parent     = glista_item_store_iter_parent;
+}
+
+/**
+ * glista_item_store_sortable_init:
+ * @iface: The sortable interface
+ *
+ * Set up the sortable implementation
+ */
+static void
+glista_item_store_sortable_init(GtkTreeSortableIface *iface)
+{
+	iface->get_sort_column_id    = glista_item_store_get_sort_column_id;
+	iface->set_sort_column_id    = glista_item_store_set_sort_column_id;
+	iface->set_sort_func         = glista_item_store_set_sort_func;
+	iface->set_default_sort_func = glista_item_store_set_default_sort_func;
+	iface->has_default_sort_func = glista_item_store_has_default_sort_func;
+}
+
+/**
+ * glista_item_store_drag_source_init:
+ * @iface: The drag source interface
+ *
+ * Set up the drag source implementation
+ */
+static void
+glista_item_store_drag_source_init(GtkTreeDragSourceIface *iface)
+{
+	iface->row_draggable    = glista_item_store_row_draggable;
+	iface->drag_data_get    = glista_item_store_drag_data_get;
+	iface->drag_data_delete = glista_item_store_drag_data_delete;
+}
+
+/**
+ * glista_item_store_drag_dest_init:
+ * @iface: The drag destination interface
+ *
+ * Set up the drag destination implementation
+ */
+static void
+glista_item_store_drag_dest_init(GtkTreeDragDestIface *iface)
+{
+	iface->row_drop_possible  = glista_item_store_row_drop_possible;
+	iface->drag_data_received = glista_item_store_drag_data_received;
+}
+
+/**
+ * glista_item_store_finalize:
+ * @object: The item store
+ *
+ * Free all rows, and the sort functions' user data
+ */
+static void
+glista_item_store_finalize(GObject *object)
+{
+	GlistaItemStore *store = GLISTA_ITEM_STORE(object);
+	guint            i;
+	
+	for (i = 0; i < store->rows->len; i++) {
+		glista_item_store_row_free(g_ptr_array_index(store->rows, i));
+	}
+	g_ptr_array_free(store->rows, TRUE);
+	
+	if (store->sort_destroy != NULL) {
+		store->sort_destroy(store->sort_data);
+	}
+	
+	if (store->default_destroy != NULL) {
+		store->default_destroy(store->default_data);
+	}
+	
+	G_OBJECT_CLASS(glista_item_store_parent_class)->finalize(object);
+}
+
+/**
+ * glista_item_store_class_init:
+ * @klass: The item store class
+ *
+ * Initialize the item store class
+ */
+static void
+glista_item_store_class_init(GlistaItemStoreClass *klass)
+{
+	G_OBJECT_CLASS(klass)->finalize = glista_item_store_finalize;
+}
+
+/**
+ * glista_item_store_init:
+ * @store: The new item store
+ *
+ * Initialize a new, unsorted item store
+ */
+static void
+glista_item_store_init(GlistaItemStore *store)
+{
+	do {
+		store->stamp = g_random_int();
+	} while (store->stamp == 0);
+	
+	store->rows        = g_ptr_array_new();
+	store->sort_column = GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID;
+	store->sort_order  = GTK_SORT_ASCENDING;
+	store->func_column = GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID;
+}
+
+/**
+ * glista_item_store_new:
+ *
+ * Create a new, empty item store
+ *
+ * Returns: The new item store
+ */
+GlistaItemStore*
+glista_item_store_new()
+{
+	return GLISTA_ITEM_STORE(g_object_new(GLISTA_TYPE_ITEM_STORE, NULL));
+}
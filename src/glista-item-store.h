@@ -0,0 +1,89 @@
+/**
+ * Glista - A simple task list management utility
+ * Copyright (C) 2008 Shahar Evron, shahar@prematureoptimization.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GLISTA_ITEM_STORE_H
+
+#include <gtk/gtk.h>
+
+#define GLISTA_TYPE_ITEM_STORE            (glista_item_store_get_type())
+#define GLISTA_ITEM_STORE(obj)            (G_TYPE_CHECK_INSTANCE_CAST((obj), \
+                                           GLISTA_TYPE_ITEM_STORE, \
+                                           GlistaItemStore))
+#define GLISTA_ITEM_STORE_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST((klass), \
+                                           GLISTA_TYPE_ITEM_STORE, \
+                                           GlistaItemStoreClass))
+#define GLISTA_IS_ITEM_STORE(obj)         (G_TYPE_CHECK_INSTANCE_TYPE((obj), \
+                                           GLISTA_TYPE_ITEM_STORE))
+
+// Get the row an item store iterator points to, without copying anything
+#define GLISTA_ITEM_STORE_ROW(iter)       ((GlistaItemRow *) (iter)->user_data)
+
+// A row in the item store, holding the values of all columns. Rows stay at
+// the same address for as long as they exist.
+typedef struct _glista_item_row GlistaItemRow;
+
+struct _glista_item_row {
+	gboolean       done;
+	gboolean       category;
+	gchar         *text;
+	gchar         *note;
+	gpointer       reminder;
+	guint64        hash;        // Content hash as of last change
+	guint          done_count;  // Number of done items in a category
+	guint          total_count; // Number of items in a category
+	gchar         *sort_key;
+	guint64        id;
+	GlistaItemRow *parent;      // The category of the row, NULL if none
+	GPtrArray     *children;    // Rows in a category, NULL if never had any
+	guint          index;       // Position of the row among its siblings
+};
+
+// The item store - the list model, with Glista's columns and DnD rules
+typedef struct {
+	GObject                 parent;
+	gint                    stamp;
+	GPtrArray              *rows;         // Rows on the root level
+	gint                    sort_column;  // Current sort column ID
+	GtkSortType             sort_order;
+	gint                    func_column;  // Column sorted with sort_func
+	GtkTreeIterCompareFunc  sort_func;
+	gpointer                sort_data;
+	GDestroyNotify          sort_destroy;
+	GtkTreeIterCompareFunc  default_func; // Default sort function
+	gpointer                default_data;
+	GDestroyNotify          default_destroy;
+} GlistaItemStore;
+
+typedef struct {
+	GObjectClass parent_class;
+} GlistaItemStoreClass;
+
+GType            glista_item_store_get_type();
+GlistaItemStore *glista_item_store_new();
+void             glista_item_store_append(GlistaItemStore *store,
+                                          GtkTreeIter *iter,
+                                          GtkTreeIter *parent);
+void             glista_item_store_remove(GlistaItemStore *store,
+                                          GtkTreeIter *iter);
+void             glista_item_store_remove_rows(GlistaItemStore *store,
+                                               GList *iters);
+void             glista_item_store_set(GlistaItemStore *store,
+                                       GtkTreeIter *iter, ...);
+
+#define __GLISTA_ITEM_STORE_H
+#endif
@@ -17,7 +17,9 @@
  */
 
 #define _XOPEN_SOURCE /* glibc2 needs this */
+#define _POSIX_C_SOURCE 199309L /* and this, for CLOCK_REALTIME */
 #include <time.h>
+#include <string.h>
 #include <glib/gi18n.h>
 #include <glib/gprintf.h>
 #include <gmodule.h>
@@ -26,22 +28,107 @@
 #include "glista.h"
 #include "glista-reminder.h"
 
+#ifdef HAVE_SYS_TIMERFD_H
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <errno.h>
+#ifndef TFD_TIMER_CANCEL_ON_SET
+#define TFD_TIMER_CANCEL_ON_SET (1 << 1)
+#endif
+#endif
+
+/**
+ * Queue of pending reminders: a binary min-heap ordered by reminder time. 
+ * Each reminder knows its position in the heap, so that it can be removed 
+ * without searching for it. While the queue is frozen, reminders are only 
+ * appended and the heap is rebuilt once when it is thawed.
+ */
+static GPtrArray *reminders        = NULL;
+static guint      reminders_frozen = 0;
+static gboolean   reminders_dirty  = FALSE;
+
 /**
- * List of pending reminders
+ * Deadline timer: armed for the time of the first reminder in the queue, or 
+ * -1 if not armed. Where available, the timer is a timerfd which also wakes 
+ * up if the system clock is set, so that clock changes and resume from 
+ * suspend are noticed. Otherwise a timeout source is used, which never sleeps
+ * for more than GLISTA_REMINDER_MAX_SLEEP seconds.
  */
-static GList *reminders      = NULL;
+static time_t      rem_armed_at      = -1;
+static guint       rem_timeout_id    = 0;
+#ifdef HAVE_SYS_TIMERFD_H
+static gint        rem_timer_fd      = -1;
+static GIOChannel *rem_timer_channel = NULL;
+static gboolean    rem_timer_failed  = FALSE;
+#endif
 
 /**
- * ID of GSource function that periodically checks for reminders due
+ * Time before which no reminders are delivered, so that missed reminders do 
+ * not compete with loading the list. See glista_reminder_catchup_delay().
  */
-static guint  rem_timeout_id = 0;
+static time_t      rem_catchup_at    = 0;
+
+/**
+ * Delivered reminders which may still be snoozed, keyed by their item ID. 
+ * Snoozing a reminder puts the same record back in the queue, and a new 
+ * reminder on the item reuses its record. While parked, the reminder time is 
+ * the time it was delivered at, and records are released after 
+ * GLISTA_REMINDER_SNOOZE_EXPIRY seconds.
+ */
+static GHashTable *rem_parked        = NULL;
+
+static void glista_reminder_check_reminders();
 
 /**
  * The reminder module and function. Loaded dynamically depending on 
- * the selected reminder messaging module.
+ * the selected reminder messaging module. Only one of the functions is set:
+ * remind_func is called on the main thread, and deliver_func on the dispatch
+ * thread. The batch function, if the module has one, is called on the same 
+ * thread as the function which is set.
+ */
+static GModule                 *remind_module = NULL;
+static gchar                   *remind_name   = NULL;
+static GlistaRHRemindFunc       remind_func   = NULL;
+static GlistaRHRemindFunc       deliver_func  = NULL;
+static GlistaRHRemindBatchFunc  batch_func    = NULL;
+
+/**
+ * Reminder dispatch thread: delivers batches of notices of due reminders 
+ * through the module's deliver function, so that slow handlers do not block
+ * the main loop. The module is only called while holding dispatch_mutex. 
+ * dispatch_pending counts batches not delivered yet, and due reminders are 
+ * held back while it is at GLISTA_REMINDER_DISPATCH_MAX.
+ */
+static GThread     *dispatch_thread    = NULL;
+static GAsyncQueue *dispatch_queue     = NULL;
+static GMutex      *dispatch_mutex     = NULL;
+static guint        dispatch_pending   = 0;
+static gboolean     dispatch_throttled = FALSE;
+
+/**
+ * Reminder module loading: modules are opened on a loader thread and then 
+ * installed on the main thread, replacing the current module once it is not
+ * delivering. Only the module of the latest load, numbered by 
+ * rem_module_serial, is installed. rem_module_failures counts consecutive 
+ * failed deliveries, and the default module is loaded instead of the 
+ * current one once it reaches GLISTA_REMINDER_MODULE_FAILURES.
+ */
+static guint     rem_module_serial   = 0;
+static gboolean  rem_module_loading  = FALSE;
+static gboolean  rem_module_failed   = FALSE;
+static gint      rem_module_failures = 0;
+
+/**
+ * A reminder module opened by the loader thread, waiting to be installed
  */
-static GModule            *remind_module = NULL;
-static GlistaRHRemindFunc  remind_func   = NULL;
+typedef struct {
+	gchar                   *name;
+	guint                    serial;
+	GModule                 *module;
+	GlistaRHRemindFunc       remind_func;
+	GlistaRHRemindFunc       deliver_func;
+	GlistaRHRemindBatchFunc  batch_func;
+} GlistaReminderModule;
 
 /**
  * glista_reminder_module_path:
@@ -65,36 +152,88 @@ glista_reminder_module_path(const gchar *mod_name)
 }
 
 /**
- * glista_reminder_init:
- * @mod_name Name of the selected reminder messaging module
+ * glista_reminder_module_selected:
+ * 
+ * Get the name of the reminder module selected in the preferences
+ * 
+ * Returns: The module name, owned by the configuration
+ */
+static const gchar*
+glista_reminder_module_selected()
+{
+	if (gl_globs->config->reminder_module != NULL) {
+		return gl_globs->config->reminder_module;
+	}
+	
+	return GLISTA_RH_MODULE;
+}
+
+/**
+ * glista_reminder_module_close:
+ * @module The module to close
+ * 
+ * Call the module's shutdown function if such function is defined, and 
+ * close the module. The module must not be delivering reminders.
+ */
+static void
+glista_reminder_module_close(GModule *module)
+{
+	GlistaRHShutdownFunc  shutdown_func;
+	GError               *shutdown_err = NULL;
+	
+	// Call the module's shutdown function
+	if (g_module_symbol(module, "glista_remindhandler_shutdown", 
+		(gpointer *) &shutdown_func)) {
+	
+		// Shut down module
+		if (! shutdown_func(&shutdown_err)) {
+			// Error shutting down module
+			if (shutdown_err != NULL) {
+				g_critical("Error shutting down remind handler module: %s", 
+					shutdown_err->message);
+		    	       
+		    	g_error_free(shutdown_err);
+			}
+		}
+	}
+	
+	// Close module
+	if (! g_module_close(module)) {
+		g_warning("Unable to properly close reminder module: %s",
+			g_module_error());
+	}
+}
+
+/**
+ * glista_reminder_module_open:
+ * @mod The module to open
  * 
- * Initialize the Glista reminder messaging module. Will open the 
- * selected module. Will also call the module's init() function if such
- * function is defined.
+ * Open the reminder messaging module named by @mod, call the module's init()
+ * function if such function is defined and look up its reminder functions.
+ * Called on the loader thread, so the module is not installed here. 
  * 
- * Return: TRUE on success, FALSE on failure. 
+ * Return: TRUE on success, FALSE on failure, in which case the module is 
+ *         closed again.
  */
 static gboolean
-glista_reminder_init(gchar *mod_name)
+glista_reminder_module_open(GlistaReminderModule *mod)
 {
 	gchar           *mod_path;
 	GlistaRHInitFuc  init_func;
 	GError          *init_error = NULL;
 	
-	glista_reminder_shutdown();
-	
-	mod_path = glista_reminder_module_path(mod_name);
-	remind_module = g_module_open(mod_path, G_MODULE_BIND_LAZY);
+	mod_path = glista_reminder_module_path(mod->name);
+	mod->module = g_module_open(mod_path, G_MODULE_BIND_LAZY);
 	g_free(mod_path);
 	
-	if (remind_module == NULL) {
-		g_critical("Unable to load reminder module %s, %s", mod_name, 
+	if (mod->module == NULL) {
+		g_critical("Unable to load reminder module %s, %s", mod->name, 
 			g_module_error());
 		return FALSE;
 	}
 	
 	// Call the module's init function if it is implemented
-	if (g_module_symbol(remind_module, "glista_remindhandler_init", 
+	if (g_module_symbol(mod->module, "glista_remindhandler_init", 
 		(gpointer *) &init_func)) {
 	
 		// Initialize module
@@ -108,393 +247,1501 @@ glista_reminder_init(gchar *mod_name)
 			    g_error_free(init_error);
 			}
 			
-			glista_reminder_shutdown();
+			g_module_close(mod->module);
+			mod->module = NULL;
 			return FALSE;
 		}
 	}
 	
-	if (! g_module_symbol(remind_module, "glista_remindhandler_remind", 
-		(gpointer *) &remind_func)) {
+	// Prefer the deliver function, which can be called off the main thread
+	if (g_module_symbol(mod->module, "glista_remindhandler_deliver", 
+		(gpointer *) &mod->deliver_func)) {
+		
+		mod->remind_func = NULL;
+		
+	} else if (! g_module_symbol(mod->module, "glista_remindhandler_remind", 
+		(gpointer *) &mod->remind_func)) {
 		
 		g_critical("Can't find reminder function symbol in %s: %s", 
-			mod_name, g_module_error());
-		glista_reminder_shutdown();
+			mod->name, g_module_error());
+		glista_reminder_module_close(mod->module);
+		mod->module = NULL;
 		return FALSE;
 	}
 	
-	if (remind_func == NULL) {
+	if (mod->remind_func == NULL && mod->deliver_func == NULL) {
 		g_critical("Reminder function symbol for %s is NULL, %s", 
-			mod_name, g_module_error());
-		glista_reminder_shutdown();
+			mod->name, g_module_error());
+		glista_reminder_module_close(mod->module);
+		mod->module = NULL;
 		return FALSE;
 	}
 	
+	// The batch function is optional
+	if (! g_module_symbol(mod->module, (mod->deliver_func != NULL ? 
+	                      "glista_remindhandler_deliver_batch" : 
+	                      "glista_remindhandler_remind_batch"), 
+	                      (gpointer *) &mod->batch_func)) {
+		mod->batch_func = NULL;
+	}
+	
 	return TRUE;
 }
 
+static void glista_reminder_module_load(const gchar *mod_name);
+
 /**
- * glista_reminder_shutdown:
+ * glista_reminder_module_install_cb:
+ * @data The module opened by the loader thread
  * 
- * Close the Glista reminder messaging module. Should be called before
- * swithing to a different module and before the program quits. 
+ * Install a module opened by the loader thread, in place of the current one. 
+ * If the current module is delivering a reminder, try again after 
+ * GLISTA_REMINDER_MODULE_RETRY milliseconds. If the module could not be 
+ * opened, fall back to the default module. Called on the main thread.
  * 
- * Will internally call the remind handler module's shutdown function if
- * such function is defined.
+ * Returns: FALSE, so that the source is removed
  */
-void 
-glista_reminder_shutdown()
+static gboolean
+glista_reminder_module_install_cb(gpointer data)
 {
-	GlistaRHShutdownFunc  shutdown_func;
-	GError               *shutdown_err = NULL;
+	GlistaReminderModule *mod = data;
 	
-	if (remind_module != NULL) {
-		// Call the module's shutdown function
-		if (g_module_symbol(remind_module, "glista_remindhandler_shutdown", 
-			(gpointer *) &shutdown_func)) {
-		
-			// Shut down module
-			if (! shutdown_func(&shutdown_err)) {
-				// Error shutting down module
-				if (shutdown_err != NULL) {
-					g_critical("Error shutting down remind handler module: %s", 
-						shutdown_err->message);
-			    	       
-			    	g_error_free(shutdown_err);
-				}
-			}
-		}
-		
-		// Close module
-		if (! g_module_close(remind_module)) {
-			g_warning("Unable to properly close reminder module: %s",
-				g_module_error());
+	// Superseded by a later load, or by shutting down
+	if (mod->serial != rem_module_serial) {
+		if (mod->module != NULL) glista_reminder_module_close(mod->module);
+		g_free(mod->name);
+		g_free(mod);
+		return FALSE;
+	}
+	
+	if (mod->module == NULL) {
+		if (strcmp(mod->name, GLISTA_RH_MODULE) != 0) {
+			g_warning("Falling back to the %s reminder module", 
+			          GLISTA_RH_MODULE);
+			glista_reminder_module_load(GLISTA_RH_MODULE);
+		} else {
+			rem_module_loading = FALSE;
+			rem_module_failed  = TRUE;
+			glista_reminder_check_reminders();
 		}
 		
-		remind_module = NULL;
+		g_free(mod->name);
+		g_free(mod);
+		return FALSE;
+	}
+	
+	if (dispatch_mutex != NULL && (! g_mutex_trylock(dispatch_mutex))) {
+		g_timeout_add(GLISTA_REMINDER_MODULE_RETRY, 
+		              glista_reminder_module_install_cb, mod);
+		return FALSE;
+	}
+	
+	if (remind_module != NULL) {
+		glista_reminder_module_close(remind_module);
+	}
+	g_free(remind_name);
+	
+	remind_module = mod->module;
+	remind_name   = mod->name;
+	remind_func   = mod->remind_func;
+	deliver_func  = mod->deliver_func;
+	batch_func    = mod->batch_func;
+	
+	if (dispatch_mutex != NULL) {
+		g_mutex_unlock(dispatch_mutex);
 	}
+	
+	g_free(mod);
+	rem_module_loading = FALSE;
+	rem_module_failed  = FALSE;
+	g_atomic_int_set(&rem_module_failures, 0);
+	
+	// Deliver reminders which came due while loading
+	glista_reminder_check_reminders();
+	
+	return FALSE;
 }
 
 /**
- * glista_reminder_insert_compare_func:
- * @a First item to compare
- * @b Second item to compare
+ * glista_reminder_module_thread:
+ * @data The module to open
  * 
- * A comparison function to be used when inserting new reminders to the list of
- * reminders. The goal is to have the reminders ordered by time, so that only 
- * the first reminder needs to be checked for due time - instead of iterating 
- * over the entire list. 
+ * Reminder module loader thread: opens a module and hands it over to the 
+ * main thread to be installed.
  * 
- * This is called internally by g_list_insert_sorted()
+ * Returns: NULL
+ */
+static gpointer
+glista_reminder_module_thread(gpointer data)
+{
+	glista_reminder_module_open((GlistaReminderModule *) data);
+	g_idle_add(glista_reminder_module_install_cb, data);
+	
+	return NULL;
+}
+
+/**
+ * glista_reminder_module_load:
+ * @mod_name Name of the reminder messaging module to load
  * 
- * Returns: 1 if a > b, -1 if a < b and 0 if they are equal
+ * Start loading a reminder messaging module. The current module, if any, 
+ * keeps delivering reminders until the new module is installed, and loads 
+ * started earlier are abandoned. 
  */
-static gint 
-glista_reminder_insert_compare_func(gconstpointer a, gconstpointer b)
+static void
+glista_reminder_module_load(const gchar *mod_name)
 {
-	GlistaReminder *a_rem, *b_rem;
+	GlistaReminderModule *mod;
+	GError               *error = NULL;
 	
-	a_rem = (GlistaReminder *) a;
-	b_rem = (GlistaReminder *) b;
+	mod = g_new0(GlistaReminderModule, 1);
+	mod->name   = g_strdup(mod_name);
+	mod->serial = ++rem_module_serial;
+	rem_module_loading = TRUE;
 	
-	if (a_rem->remind_at > b_rem->remind_at) {
-		return 1;
-	} else if (a_rem->remind_at < b_rem->remind_at) {
-		return -1;
-	} else {
-		return 0;
+	if (g_thread_create(glista_reminder_module_thread, mod, FALSE, 
+	                    &error) == NULL) {
+		g_warning("Unable to start reminder module loader thread: %s", 
+		          error->message);
+		g_error_free(error);
+		
+		glista_reminder_module_open(mod);
+		glista_reminder_module_install_cb(mod);
 	}
 }
 
 /**
- * glista_reminder_new:
- * @ref  A reference pointing to the item in the model
- * @time Reminder time
+ * glista_reminder_module_fallback_cb:
+ * @data Not used
  * 
- * Initialize a new reminder object
+ * Load the default module in place of a module which keeps failing to 
+ * deliver reminders. Called on the main thread.
+ * 
+ * Returns: FALSE, so that the source is removed
  */
-static GlistaReminder*
-glista_reminder_new(GtkTreeRowReference *ref, time_t time)
+static gboolean
+glista_reminder_module_fallback_cb(gpointer data)
 {
-	GlistaReminder      *reminder;
-	GtkTreeRowReference *ref_copy;
-	
-	ref_copy = gtk_tree_row_reference_copy(ref);
-	
-	reminder = g_malloc(sizeof(GlistaReminder));
-	reminder->item_ref  = ref_copy;
-	reminder->remind_at = time;	
+	if (remind_name != NULL && (! rem_module_loading) && 
+	    strcmp(remind_name, GLISTA_RH_MODULE) != 0) {
+		g_warning("Reminder module %s keeps failing, falling back to the "
+		          "%s reminder module", remind_name, GLISTA_RH_MODULE);
+		glista_reminder_module_load(GLISTA_RH_MODULE);
+	}
 	
-	return reminder;
+	return FALSE;
 }
- 
+
 /**
- * glista_reminder_free:
- * @reminder The reminder object to free
+ * glista_reminder_set_module:
+ * @mod_name Name of the selected reminder messaging module
  * 
- * Free a reminder object
+ * Switch to a different reminder messaging module without restarting. If no
+ * module was loaded yet, the selected module is loaded once there is a 
+ * reminder to deliver.
  */
 void
-glista_reminder_free(GlistaReminder *reminder)
+glista_reminder_set_module(const gchar *mod_name)
 {
-	gtk_tree_row_reference_free(reminder->item_ref);
-	g_free(reminder);
+	if (remind_module == NULL && (! rem_module_loading) && 
+	    (! rem_module_failed)) {
+		return;
+	}
+	
+	if (remind_name != NULL && (! rem_module_loading) &&
+	    strcmp(remind_name, mod_name) == 0) {
+		return;
+	}
+	
+	rem_module_failed = FALSE;
+	glista_reminder_module_load(mod_name);
 }
 
 /**
- * glista_reminder_error_quark:
+ * glista_reminder_shutdown:
  * 
- * Get the error domain GQuark for glista reminders functionality. 
- * You should use the GLISTA_REMINDER_ERROR_QUARK constant and not this 
- * function directly
+ * Close the Glista reminder messaging module. Should be called before
+ * the program quits. Modules still being loaded are abandoned.
  * 
- * Returns: the error quark for this module
+ * Will internally call the remind handler module's shutdown function if
+ * such function is defined. If the dispatch thread is still delivering a 
+ * reminder through the module, the module is left open, since it can not 
+ * be shut down safely.
  */
-GQuark
-glista_reminder_error_quark()
+void 
+glista_reminder_shutdown()
 {
-	static GQuark equark = 0;
+	rem_module_serial++;
+	rem_module_loading = FALSE;
 	
-	if (equark == 0) { 
-		equark = g_quark_from_static_string(GLISTA_REMINDER_ERROR_QUARK_S);
+	if (remind_module == NULL) {
+		return;
 	}
 	
-	return equark;
+	remind_func  = NULL;
+	deliver_func = NULL;
+	batch_func   = NULL;
+	g_free(remind_name);
+	remind_name  = NULL;
+	
+	if (dispatch_mutex != NULL && (! g_mutex_trylock(dispatch_mutex))) {
+		g_warning("Reminder module is busy delivering, leaving it open");
+		remind_module = NULL;
+		return;
+	}
+	
+	glista_reminder_module_close(remind_module);
+	remind_module = NULL;
+	
+	if (dispatch_mutex != NULL) {
+		g_mutex_unlock(dispatch_mutex);
+	}
 }
 
+#define REMINDER_AT(i) ((GlistaReminder *) g_ptr_array_index(reminders, (i)))
+
 /**
- * glista_reminder_call_mod_remind:
- * @reminder The reminder object to handle
+ * glista_reminder_heap_swap:
+ * @i Position of the first reminder
+ * @j Position of the second reminder
  * 
- * Call the reminder module function which is supposed to do the 
- * actual "reminding". 
+ * Swap two reminders in the heap, keeping their positions up to date
  */
 static void
-glista_reminder_call_reminder_func(GlistaReminder *reminder)
+glista_reminder_heap_swap(guint i, guint j)
 {
-	GError *error = NULL;
+	gpointer tmp;
 	
-	if (remind_func == NULL) {
-		return;
-	}
+	tmp = reminders->pdata[i];
+	reminders->pdata[i] = reminders->pdata[j];
+	reminders->pdata[j] = tmp;
 	
-	// Call the remind handler module remind function
-	if (! remind_func(reminder, &error)) {
-		// There was some error
-		if (error != NULL) {
-			g_warning("Error calling remind handler: %s", error->message);
-			g_error_free(error);
-		}
-	}
+	REMINDER_AT(i)->heap_index = i;
+	REMINDER_AT(j)->heap_index = j;
 }
 
 /**
- * glista_reminder_check_reminders:
- * @data data passed at scheduling time
- * 
- * Periodically called to check if any reminders are due - and if so, will 
- * call glista_reminder_remind() for them and then remove them from the list. 
+ * glista_reminder_heap_up:
+ * @i Position of the reminder to move
  * 
- * This function is executed in intervals using the g_timeout mechanism.
- * 
- * If the list of reminders is empty, the timeout will be cleared until new 
- * reminders are added. 
+ * Move a reminder towards the top of the heap until its parent is due before
+ * it
  */
-static gboolean 
-glista_reminder_check_reminders(gpointer data)
+static void
+glista_reminder_heap_up(guint i)
 {
-	GList          *rem_node;
-	GlistaReminder *reminder;
-	time_t          now;
+	guint parent;
 	
-	while (reminders != NULL) {
-		// Find the current time and compare to first reminder
-		time(&now);
-		reminder = (GlistaReminder *) reminders->data;
+	while (i > 0) {
+		parent = (i - 1) / 2;
+		if (REMINDER_AT(parent)->remind_at <= REMINDER_AT(i)->remind_at) break;
 		
-		if (now >= reminder->remind_at) {	
-			GtkTreePath *path;
-			GtkTreeIter  iter;
-			gboolean     is_done;
-			
-			if ((path = gtk_tree_row_reference_get_path(
-				 reminder->item_ref)) != NULL) {
-				
-				if (gtk_tree_model_get_iter(GL_ITEMSTM, &iter, path)) {
-												
-					gtk_tree_model_get(GL_ITEMSTM, &iter, 
-					                   GL_COLUMN_DONE, &is_done, -1);
-					
-					// Remind
-					if (! is_done) {
-						glista_reminder_call_reminder_func(reminder);
-					}
-					
-					// Clear reminder from item
-					gtk_tree_store_set(gl_globs->itemstore, &iter, 
-			        		           GL_COLUMN_REMINDER, NULL, -1);
-				}
-			}
-			
-			// Remove reminder from list and free it
-			glista_reminder_free(reminder);
-			rem_node = reminders;
-			reminders = g_list_remove_link(reminders, rem_node);
-			g_list_free_1(rem_node);
-			
-		} else {
-			// If the first reminder is not due yet, break.
-			break;
-		}
+		glista_reminder_heap_swap(i, parent);
+		i = parent;
 	}
+}
+
+/**
+ * glista_reminder_heap_down:
+ * @i Position of the reminder to move
+ * 
+ * Move a reminder towards the bottom of the heap until both its children are
+ * due after it
+ */
+static void
+glista_reminder_heap_down(guint i)
+{
+	guint child;
 	
-	if (reminders == NULL) { 
-		// We are out of reminders
-		rem_timeout_id = 0;
-		return FALSE;
-	} else {
-		return TRUE;
+	while ((child = 2 * i + 1) < reminders->len) {
+		if (child + 1 < reminders->len && 
+		    REMINDER_AT(child + 1)->remind_at < REMINDER_AT(child)->remind_at) {
+			child++;
+		}
+		if (REMINDER_AT(i)->remind_at <= REMINDER_AT(child)->remind_at) break;
+		
+		glista_reminder_heap_swap(i, child);
+		i = child;
 	}
 }
 
 /**
- * glista_reminder_remove:
- * @reminder Reminder to clear out
+ * glista_reminder_queue_add:
+ * @reminder The reminder to add
  * 
- * Remove an existing reminder from the reminders queue and free it.
+ * Add a reminder to the queue of pending reminders
  */
-void 
-glista_reminder_remove(GlistaReminder *reminder)
+static void
+glista_reminder_queue_add(GlistaReminder *reminder)
 {
-	reminders = g_list_remove_all(reminders, reminder);
-	glista_reminder_free(reminder);
+	if (reminders == NULL) {
+		reminders = g_ptr_array_new();
+	}
+	
+	reminder->heap_index = reminders->len;
+	g_ptr_array_add(reminders, reminder);
+	
+	if (reminders_frozen > 0) {
+		reminders_dirty = TRUE;
+	} else {
+		glista_reminder_heap_up(reminder->heap_index);
+	}
 }
 
-void 
-glista_reminder_remove_selected()
+/**
+ * glista_reminder_queue_remove:
+ * @reminder The reminder to remove
+ * 
+ * Remove a reminder from the queue of pending reminders. The last reminder in
+ * the heap takes its place, and is moved up or down as needed.
+ */
+static void
+glista_reminder_queue_remove(GlistaReminder *reminder)
 {
-	GList   *selected, *node;
+	GlistaReminder *moved;
+	guint           i, last;
 	
-	// Iterate over list of selected rows
-	selected = glista_list_get_selected();	
-	for (node = selected; node != NULL; node = node->next) {
-	    GtkTreePath *path;
-
-        path = gtk_tree_row_reference_get_path(
-			(GtkTreeRowReference *)node->data
-		);
-		
-        if (path) {
-        	GtkTreeIter     iter;
-			GlistaReminder *reminder;
-			
-	        if (gtk_tree_model_get_iter(GL_ITEMSTM, &iter, path)) {
-				gtk_tree_model_get(GL_ITEMSTM, &iter, 
-				                   GL_COLUMN_REMINDER, &reminder, -1);
-								   
-				if (reminder != NULL) {
-					glista_reminder_remove(reminder);
-					gtk_tree_store_set(GL_ITEMSTS, &iter, 
-								       GL_COLUMN_REMINDER, NULL, -1);
-				}
-			}
-
-			gtk_tree_path_free(path);
-        }
+	i = reminder->heap_index;
+	g_return_if_fail(reminders != NULL && i < reminders->len && 
+	                 REMINDER_AT(i) == reminder);
+	
+	last = reminders->len - 1;
+	if (i != last) {
+		glista_reminder_heap_swap(i, last);
 	}
+	g_ptr_array_remove_index(reminders, last);
 	
-	// Free the list of selected rows
-	g_list_foreach(selected, (GFunc) gtk_tree_row_reference_free, NULL);
-	g_list_free (selected);
+	if (i < reminders->len) {
+		if (reminders_frozen > 0) {
+			reminders_dirty = TRUE;
+		} else {
+			moved = REMINDER_AT(i);
+			glista_reminder_heap_up(i);
+			glista_reminder_heap_down(moved->heap_index);
+		}
+	}
 }
 
 /**
- * glista_reminder_set:
- * @item_ref  A reference to the item to set a reminder on
- * @remind_at The time to remind at
+ * glista_reminder_timeout_cb:
+ * @data Unused
  * 
- * Set a new reminder for an item.
+ * Called when the fallback timeout expires. Checks for reminders due, which 
+ * arms the timer again if needed.
  * 
- * If not done already, will start the periodical reminder checks.
+ * Returns: FALSE, so that the timeout source is removed
  */
-void
-glista_reminder_set(GtkTreeRowReference *item_ref, time_t remind_at)
+static gboolean
+glista_reminder_timeout_cb(gpointer data)
 {
-	GlistaReminder *reminder;
-	GtkTreePath    *path;
-	GtkTreeIter     iter;
+	rem_timeout_id = 0;
+	rem_armed_at   = -1;
 	
-	if ((path = gtk_tree_row_reference_get_path(item_ref)) != NULL) {
-		if (gtk_tree_model_get_iter(GL_ITEMSTM, &iter, path)) {		
-				
-			// Check if the item is a category - if so set on all children
-			if (gtk_tree_model_iter_has_child(GL_ITEMSTM, &iter)) {
-				GtkTreeIter child;
-				gint i;
-				
-				// Iterate over childred calling glista_reminder_set() on them
-				for (i = 0; gtk_tree_model_iter_nth_child(GL_ITEMSTM, &child, 
-				                                          &iter, i); i++) {
-					GtkTreeRowReference *c_ref;
-					GtkTreePath         *c_path;
-					
-					c_path = gtk_tree_model_get_path(GL_ITEMSTM, &child);
-					c_ref = gtk_tree_row_reference_new(GL_ITEMSTM, c_path);
-					
-					glista_reminder_set(c_ref, remind_at);
-					
-					gtk_tree_path_free(c_path);
-					gtk_tree_row_reference_free(c_ref);
-				}
-				
-				return;
-			}
+	glista_reminder_check_reminders();
+	
+	return FALSE;
+}
 
-			// Create a new GlistaReminder struct
-			reminder = glista_reminder_new(item_ref, remind_at);
-			reminders = g_list_insert_sorted(reminders, (gpointer) reminder, 
-				(GCompareFunc) glista_reminder_insert_compare_func);
-			
-			// Set the item "reminder" column to point to the reminder object
-			gtk_tree_store_set(gl_globs->itemstore, &iter, 
-			                   GL_COLUMN_REMINDER, (gpointer) reminder, -1);
-			
-			// Make sure we have an inverval to check reminders
-			if (rem_timeout_id == 0) {
-				if (remind_module == NULL) {
-					glista_reminder_init(GLISTA_RH_MODULE);
-				}
-				rem_timeout_id = g_timeout_add_seconds(GLISTA_REMINDER_INTERVAL,
-					(GSourceFunc) glista_reminder_check_reminders, NULL);
-			}
-		}
-		
-		gtk_tree_path_free(path);
+#ifdef HAVE_SYS_TIMERFD_H
+/**
+ * glista_reminder_timerfd_cb:
+ * @source    The timer channel
+ * @condition The condition which triggered the watch
+ * @data      Unused
+ * 
+ * Called when the timerfd expires, or when the system clock was set. Either 
+ * way, checks for reminders due and arms the timer again.
+ * 
+ * Returns: TRUE, so that the timer keeps being watched
+ */
+static gboolean
+glista_reminder_timerfd_cb(GIOChannel *source, GIOCondition condition, 
+                           gpointer data)
+{
+	guint64 expirations;
+	
+	// Fails with ECANCELED if the clock was set - which we handle the same
+	if (read(rem_timer_fd, &expirations, sizeof(expirations)) == -1 &&
+	    errno != ECANCELED && errno != EAGAIN) {
+		g_warning("Unable to read reminder timer: %s", g_strerror(errno));
 	}
+	
+	rem_armed_at = -1;
+	glista_reminder_check_reminders();
+	
+	return TRUE;
 }
 
 /**
- * glista_reminder_set_on_selected:
- * @remind_at Time to remind at
+ * glista_reminder_timerfd_arm:
+ * @deadline Time to expire at, or -1 to disarm the timer
  * 
- * Set reminders at the specified time on all currently selected items 
+ * Arm the timerfd for an absolute wall clock time, creating it if needed. The
+ * timer is created as cancelable, so that it also expires if the clock is 
+ * set.
+ * 
+ * Returns: TRUE on success, FALSE if a timerfd can not be used
  */
-void
-glista_reminder_set_on_selected(time_t remind_at)
+static gboolean
+glista_reminder_timerfd_arm(time_t deadline)
 {
-	GList *ref_list, *node;
+	struct itimerspec spec;
 	
-	ref_list = glista_list_get_selected();
+	if (rem_timer_failed) return FALSE;
 	
-	// Iterate over the selected rows, and set a reminder
-	for (node = ref_list; node != NULL; node = node->next) {
-		GtkTreeRowReference *row_ref = node->data;
+	if (rem_timer_fd == -1) {
+		if (deadline == -1) return TRUE;
 		
-		glista_reminder_set(row_ref, remind_at);
-		gtk_tree_row_reference_free(row_ref);
+		if ((rem_timer_fd = timerfd_create(CLOCK_REALTIME, 
+		                                   TFD_NONBLOCK)) == -1) {
+			rem_timer_failed = TRUE;
+			return FALSE;
+		}
+		
+		rem_timer_channel = g_io_channel_unix_new(rem_timer_fd);
+		g_io_add_watch(rem_timer_channel, G_IO_IN, 
+		               (GIOFunc) glista_reminder_timerfd_cb, NULL);
+	}
+	
+	// A zero expiration time disarms the timer
+	memset(&spec, 0, sizeof(spec));
+	if (deadline != -1) {
+		spec.it_value.tv_sec = MAX(deadline, 1);
+	}
+	
+	if (timerfd_settime(rem_timer_fd, 
+	                    TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, 
+	                    &spec, NULL) == -1) {
+		// Kernel does not support cancelable timers - fall back to polling
+		rem_timer_failed = TRUE;
+		
+		memset(&spec, 0, sizeof(spec));
+		timerfd_settime(rem_timer_fd, 0, &spec, NULL);
+		return FALSE;
+	}
+	
+	return TRUE;
+}
+#endif
+
+/**
+ * glista_reminder_schedule:
+ * 
+ * Arm the deadline timer for the first reminder in the queue, or disarm it 
+ * if there are no reminders. The timer is only changed if the first reminder
+ * changed, so this is cheap to call after any change to the queue.
+ */
+static void
+glista_reminder_schedule()
+{
+	time_t deadline, delay;
+	
+	if (reminders_frozen > 0) return;
+	
+	deadline = (reminders == NULL || reminders->len == 0 ? -1 : 
+	            MAX(REMINDER_AT(0)->remind_at, rem_catchup_at));
+	if (deadline == rem_armed_at) return;
+	
+	// Load the reminder module once there is anything to remind of
+	if (rem_armed_at == -1 && remind_module == NULL && 
+	    (! rem_module_loading) && (! rem_module_failed)) {
+		glista_reminder_module_load(glista_reminder_module_selected());
+	}
+	
+	rem_armed_at = deadline;
+	
+	if (rem_timeout_id != 0) {
+		g_source_remove(rem_timeout_id);
+		rem_timeout_id = 0;
+	}
+	
+#ifdef HAVE_SYS_TIMERFD_H
+	if (glista_reminder_timerfd_arm(deadline)) return;
+#endif
+	
+	if (deadline != -1) {
+		delay = CLAMP(deadline - time(NULL), 0, GLISTA_REMINDER_MAX_SLEEP);
+		rem_timeout_id = g_timeout_add_seconds((guint) delay, 
+			(GSourceFunc) glista_reminder_timeout_cb, NULL);
+	}
+}
+
+/**
+ * glista_reminder_queue_freeze:
+ * 
+ * Stop keeping the reminders queue in order, so that adding many reminders, 
+ * as when the list is loaded, does not cost a heap insert each. No reminders
+ * are due while the queue is frozen. Calls can be nested.
+ */
+void
+glista_reminder_queue_freeze()
+{
+	reminders_frozen++;
+}
+
+/**
+ * glista_reminder_queue_thaw:
+ * 
+ * Thaw the reminders queue. When the outermost freeze ends, the heap is 
+ * rebuilt in a single pass if it was changed while frozen.
+ */
+void
+glista_reminder_queue_thaw()
+{
+	gint i;
+	
+	g_return_if_fail(reminders_frozen > 0);
+	
+	if (--reminders_frozen == 0 && reminders_dirty) {
+		for (i = (gint) reminders->len / 2 - 1; i >= 0; i--) {
+			glista_reminder_heap_down(i);
+		}
+		reminders_dirty = FALSE;
+	}
+	
+	if (reminders_frozen == 0) {
+		glista_reminder_schedule();
+	}
+}
+
+/**
+ * glista_reminder_repeat_parse:
+ * @reminder The reminder to set the recurrence rule of
+ * @rule     Recurrence rule string, or NULL if the reminder does not repeat
+ * 
+ * Parse a recurrence rule string into a reminder. Unknown or invalid rules are
+ * ignored, and the reminder does not repeat.
+ */
+static void
+glista_reminder_repeat_parse(GlistaReminder *reminder, const gchar *rule)
+{
+	gchar **parts;
+	guint   arg = 0;
+	
+	reminder->repeat     = GLISTA_REPEAT_NONE;
+	reminder->repeat_arg = 0;
+	
+	if (rule == NULL || *rule == '\0') return;
+	
+	parts = g_strsplit(rule, ":", 2);
+	if (parts[1] != NULL) {
+		arg = (guint) g_ascii_strtoull(parts[1], NULL, 10);
+	}
+	
+	if (strcmp(parts[0], GLISTA_REPEAT_RULE_DAILY) == 0) {
+		reminder->repeat = GLISTA_REPEAT_DAILY;
+		
+	} else if (strcmp(parts[0], GLISTA_REPEAT_RULE_WEEKDAYS) == 0) {
+		reminder->repeat = GLISTA_REPEAT_WEEKDAYS;
+		
+	} else if (strcmp(parts[0], GLISTA_REPEAT_RULE_HOURS) == 0 && arg > 0) {
+		reminder->repeat     = GLISTA_REPEAT_HOURS;
+		reminder->repeat_arg = arg;
+		
+	} else if (strcmp(parts[0], GLISTA_REPEAT_RULE_MONTHLY) == 0 && 
+	           arg >= 1 && arg <= 31) {
+		reminder->repeat     = GLISTA_REPEAT_MONTHLY;
+		reminder->repeat_arg = arg;
+		
+	} else {
+		g_warning("Ignoring unknown reminder recurrence rule '%s'", rule);
+	}
+	
+	g_strfreev(parts);
+}
+
+/**
+ * glista_reminder_next_occurrence:
+ * @reminder A recurring reminder
+ * @after    Time after which the next occurrence should be
+ * 
+ * Compute the first occurrence of a recurring reminder which is after @after.
+ * Daily and monthly reminders keep their local time of day across DST 
+ * changes. Periods missed in between are skipped at once rather than one by 
+ * one, so this takes a few steps at most.
+ * 
+ * Returns: Time of the next occurrence
+ */
+static time_t
+glista_reminder_next_occurrence(GlistaReminder *reminder, time_t after)
+{
+	struct tm base, tm;
+	time_t    next, step, missed;
+	gint      n, month;
+	
+	missed = MAX(after - reminder->remind_at, 0);
+	
+	if (reminder->repeat == GLISTA_REPEAT_HOURS) {
+		step = (time_t) reminder->repeat_arg * 3600;
+		return reminder->remind_at + (missed / step + 1) * step;
+	}
+	
+	localtime_r(&(reminder->remind_at), &base);
+	
+	if (reminder->repeat == GLISTA_REPEAT_MONTHLY) {
+		n = (gint) (missed / (31 * 86400)) + 1;
+	} else {
+		n = (gint) MAX(missed / 86400 - 1, 0) + 1;
+	}
+	
+	do {
+		tm = base;
+		tm.tm_isdst = -1;
+		
+		if (reminder->repeat == GLISTA_REPEAT_MONTHLY) {
+			// Repeat on the last day of months shorter than the set day
+			month = base.tm_mon + n;
+			tm.tm_year = base.tm_year + month / 12;
+			tm.tm_mon  = month % 12;
+			tm.tm_mday = MIN((gint) reminder->repeat_arg, 
+			                 g_date_get_days_in_month(
+			                     (GDateMonth) (tm.tm_mon + 1), 
+			                     (GDateYear) (tm.tm_year + 1900)));
+		} else {
+			tm.tm_mday = base.tm_mday + n;
+		}
+		
+		next = mktime(&tm);
+		n++;
+		
+	} while (next <= after || (reminder->repeat == GLISTA_REPEAT_WEEKDAYS && 
+	                           (tm.tm_wday == 0 || tm.tm_wday == 6)));
+	
+	return next;
+}
+
+/**
+ * glista_reminder_catchup_delay:
+ * @seconds Number of seconds to hold reminders back for
+ * 
+ * Hold back all reminders for a while. Called once the list is loaded, so 
+ * that reminders missed while Glista was not running are only delivered once
+ * the UI has settled, and not on the startup path.
+ */
+void
+glista_reminder_catchup_delay(guint seconds)
+{
+	rem_catchup_at = time(NULL) + (time_t) seconds;
+	glista_reminder_schedule();
+}
+
+/**
+ * glista_reminder_id_hash:
+ * @key Pointer to an item ID
+ * 
+ * GHashFunc for tables keyed by item IDs
+ * 
+ * Returns: Hash of the item ID
+ */
+static guint
+glista_reminder_id_hash(gconstpointer key)
+{
+	guint64 id = *((const guint64 *) key);
+	
+	return (guint) (id ^ (id >> 32));
+}
+
+/**
+ * glista_reminder_id_equal:
+ * @a First key to compare
+ * @b Second key to compare
+ * 
+ * GEqualFunc for tables keyed by item IDs
+ * 
+ * Returns: TRUE if both keys are equal
+ */
+static gboolean
+glista_reminder_id_equal(gconstpointer a, gconstpointer b)
+{
+	return (*((const guint64 *) a) == *((const guint64 *) b));
+}
+
+/**
+ * glista_reminder_park:
+ * @reminder A reminder which was delivered and removed from the queue
+ * @now      Current time
+ * 
+ * Keep a delivered reminder around, so that it can be snoozed. The record 
+ * is keyed by its own item ID, so parking does not allocate anything.
+ */
+static void
+glista_reminder_park(GlistaReminder *reminder, time_t now)
+{
+	if (rem_parked == NULL) {
+		rem_parked = g_hash_table_new_full(glista_reminder_id_hash, 
+		                                   glista_reminder_id_equal, NULL, 
+		                                   (GDestroyNotify) glista_reminder_free);
+	}
+	
+	reminder->remind_at = now;
+	g_hash_table_replace(rem_parked, &(reminder->item_id), reminder);
+}
+
+/**
+ * glista_reminder_parked_expired:
+ * @key       Item ID
+ * @reminder  Parked reminder
+ * @now       Pointer to the current time
+ * 
+ * Tell whether a parked reminder was delivered long enough ago to release
+ * 
+ * Returns: TRUE if the reminder should be released
+ */
+static gboolean
+glista_reminder_parked_expired(gpointer key, GlistaReminder *reminder, 
+                               time_t *now)
+{
+	return (*now - reminder->remind_at > GLISTA_REMINDER_SNOOZE_EXPIRY);
+}
+
+/**
+ * glista_reminder_snooze:
+ * @item_id The ID of the item whose reminder was delivered
+ * @seconds Number of seconds to snooze for
+ * 
+ * Remind about an item again in a while. The record of the delivered 
+ * reminder is moved back into the queue, and the item points to it again. 
+ * Nothing is done if the reminder is no longer parked, if the item is gone or 
+ * if a new reminder was set on it meanwhile. Meant to be called by reminder 
+ * modules, on the main thread, when the user asks to snooze a notice.
+ */
+void
+glista_reminder_snooze(guint64 item_id, guint seconds)
+{
+	GlistaReminder *reminder, *current;
+	GtkTreeIter     iter;
+	
+	if (rem_parked == NULL || 
+	    (reminder = g_hash_table_lookup(rem_parked, &item_id)) == NULL) {
+		return;
+	}
+	
+	if (glista_item_get_iter(item_id, &iter)) {
+		gtk_tree_model_get(GL_ITEMSTM, &iter, 
+		                   GL_COLUMN_REMINDER, &current, -1);
+		if (current == NULL) {
+			g_hash_table_steal(rem_parked, &item_id);
+			
+			reminder->remind_at = time(NULL) + (time_t) seconds;
+			glista_reminder_queue_add(reminder);
+			glista_item_store_set(gl_globs->itemstore, &iter, 
+			                      GL_COLUMN_REMINDER, reminder, -1);
+			glista_reminder_schedule();
+			return;
+		}
+	}
+	
+	g_hash_table_remove(rem_parked, &item_id);
+}
+
+/**
+ * glista_reminder_new:
+ * @item_id The ID of the item in the model
+ * @time    Reminder time
+ * @repeat  Recurrence rule, or NULL if the reminder does not repeat
+ * 
+ * Initialize a new reminder object
+ */
+static GlistaReminder*
+glista_reminder_new(guint64 item_id, time_t time, const gchar *repeat)
+{
+	GlistaReminder *reminder;
+	
+	// Reuse the record of the last reminder on this item, if still parked
+	if (rem_parked != NULL && 
+	    (reminder = g_hash_table_lookup(rem_parked, &item_id)) != NULL) {
+		g_hash_table_steal(rem_parked, &item_id);
+	} else {
+		reminder = g_malloc(sizeof(GlistaReminder));
+	}
+	
+	reminder->item_id    = item_id;
+	reminder->remind_at  = time;	
+	reminder->heap_index = 0;
+	glista_reminder_repeat_parse(reminder, repeat);
+	
+	return reminder;
+}
+
+/**
+ * glista_reminder_get_repeat:
+ * @reminder The reminder
+ * 
+ * Get the recurrence rule of a reminder, as stored with the item
+ * 
+ * Returns: A newly allocated rule string, or NULL if the reminder does not 
+ *          repeat
+ */
+gchar*
+glista_reminder_get_repeat(GlistaReminder *reminder)
+{
+	switch (reminder->repeat) {
+		case GLISTA_REPEAT_DAILY:
+			return g_strdup(GLISTA_REPEAT_RULE_DAILY);
+			
+		case GLISTA_REPEAT_WEEKDAYS:
+			return g_strdup(GLISTA_REPEAT_RULE_WEEKDAYS);
+			
+		case GLISTA_REPEAT_HOURS:
+			return g_strdup_printf("%s:%u", GLISTA_REPEAT_RULE_HOURS, 
+			                       reminder->repeat_arg);
+			
+		case GLISTA_REPEAT_MONTHLY:
+			return g_strdup_printf("%s:%u", GLISTA_REPEAT_RULE_MONTHLY, 
+			                       reminder->repeat_arg);
+			
+		default:
+			return NULL;
+	}
+}
+ 
+/**
+ * glista_reminder_free:
+ * @reminder The reminder object to free
+ * 
+ * Free a reminder object
+ */
+void
+glista_reminder_free(GlistaReminder *reminder)
+{
+	g_free(reminder);
+}
+
+/**
+ * glista_reminder_error_quark:
+ * 
+ * Get the error domain GQuark for glista reminders functionality. 
+ * You should use the GLISTA_REMINDER_ERROR_QUARK constant and not this 
+ * function directly
+ * 
+ * Returns: the error quark for this module
+ */
+GQuark
+glista_reminder_error_quark()
+{
+	static GQuark equark = 0;
+	
+	if (equark == 0) { 
+		equark = g_quark_from_static_string(GLISTA_REMINDER_ERROR_QUARK_S);
+	}
+	
+	return equark;
+}
+
+/**
+ * glista_reminder_notice_new:
+ * @reminder The due reminder
+ * @iter     Iterator pointing to the reminder's item
+ * 
+ * Copy everything a remind handler needs to know about a due reminder from 
+ * the list. Must be called on the main thread.
+ * 
+ * Returns: A newly allocated notice, to be freed with 
+ *          glista_reminder_notice_free()
+ */
+static GlistaReminderNotice*
+glista_reminder_notice_new(GlistaReminder *reminder, GtkTreeIter *iter)
+{
+	GlistaReminderNotice *notice;
+	GtkTreeIter           parent;
+	
+	notice = g_new0(GlistaReminderNotice, 1);
+	notice->item_id   = reminder->item_id;
+	notice->remind_at = reminder->remind_at;
+	
+	gtk_tree_model_get(GL_ITEMSTM, iter, GL_COLUMN_TEXT, &notice->text, -1);
+	if (gtk_tree_model_iter_parent(GL_ITEMSTM, &parent, iter)) {
+		gtk_tree_model_get(GL_ITEMSTM, &parent, 
+		                   GL_COLUMN_TEXT, &notice->category, -1);
+	}
+	
+	return notice;
+}
+
+/**
+ * glista_reminder_notice_free:
+ * @notice The notice to free
+ * 
+ * Free a reminder notice
+ */
+static void
+glista_reminder_notice_free(GlistaReminderNotice *notice)
+{
+	g_free(notice->text);
+	g_free(notice->category);
+	g_free(notice);
+}
+
+/**
+ * glista_reminder_batch_new:
+ * 
+ * Create a new, empty batch of reminder notices
+ * 
+ * Returns: A newly allocated batch, to be freed with 
+ *          glista_reminder_batch_free()
+ */
+static GlistaReminderBatch*
+glista_reminder_batch_new()
+{
+	GlistaReminderBatch *batch;
+	
+	batch = g_new0(GlistaReminderBatch, 1);
+	batch->notices = g_ptr_array_new();
+	
+	return batch;
+}
+
+/**
+ * glista_reminder_batch_free:
+ * @batch The batch to free
+ * 
+ * Free a batch of reminder notices, including the notices
+ */
+static void
+glista_reminder_batch_free(GlistaReminderBatch *batch)
+{
+	g_ptr_array_foreach(batch->notices, 
+	                    (GFunc) glista_reminder_notice_free, NULL);
+	g_ptr_array_free(batch->notices, TRUE);
+	g_free(batch->summary);
+	g_free(batch);
+}
+
+/**
+ * glista_reminder_batch_summarize:
+ * @batch The batch to summarize
+ * 
+ * Build the one line summary of a batch, listing the text of the first 
+ * GLISTA_REMINDER_SUMMARY_ITEMS items in it.
+ */
+static void
+glista_reminder_batch_summarize(GlistaReminderBatch *batch)
+{
+	GlistaReminderNotice *notice;
+	GString              *items;
+	guint                 i;
+	
+	items = g_string_new(NULL);
+	for (i = 0; i < batch->notices->len && 
+	            i < GLISTA_REMINDER_SUMMARY_ITEMS; i++) {
+		notice = g_ptr_array_index(batch->notices, i);
+		if (i > 0) g_string_append(items, ", ");
+		g_string_append(items, notice->text);
+	}
+	
+	if (i < batch->notices->len) {
+		g_string_append_printf(items, _(" and %u more"), 
+		                       batch->notices->len - i);
+	}
+	
+	batch->summary = g_strdup_printf(_("%u tasks are due: %s"), 
+	                                 batch->notices->len, items->str);
+	g_string_free(items, TRUE);
+}
+
+/**
+ * glista_reminder_call_reminder_func:
+ * @func       The module function to call for a single notice
+ * @batch_func The module function to call for a batch, or NULL
+ * @batch      The batch of notices to deliver
+ * 
+ * Call the reminder module function which is supposed to do the 
+ * actual "reminding". A batch of a single notice is delivered as a single
+ * notice. If the module does not handle batches, the summary of the batch is
+ * delivered as a single notice instead. Once the module failed 
+ * GLISTA_REMINDER_MODULE_FAILURES times in a row, the main thread is told to
+ * fall back to the default module.
+ */
+static void
+glista_reminder_call_reminder_func(GlistaRHRemindFunc func, 
+                                   GlistaRHRemindBatchFunc batch_func,
+                                   GlistaReminderBatch *batch)
+{
+	GlistaReminderNotice  summary, *first;
+	GError               *error = NULL;
+	gboolean              success;
+	
+	first = g_ptr_array_index(batch->notices, 0);
+	
+	// Call the remind handler module remind function
+	if (batch->notices->len == 1) {
+		success = func(first, &error);
+		
+	} else if (batch_func != NULL) {
+		success = batch_func(batch, &error);
+		
+	} else {
+		summary.item_id   = 0;
+		summary.text      = batch->summary;
+		summary.category  = NULL;
+		summary.remind_at = first->remind_at;
+		success = func(&summary, &error);
+	}
+	
+	if (success) {
+		g_atomic_int_set(&rem_module_failures, 0);
+		
+	} else {
+		// There was some error
+		if (error != NULL) {
+			g_warning("Error calling remind handler: %s", error->message);
+			g_error_free(error);
+		}
+		
+		if (g_atomic_int_exchange_and_add(&rem_module_failures, 1) + 1 == 
+		    GLISTA_REMINDER_MODULE_FAILURES) {
+			g_idle_add(glista_reminder_module_fallback_cb, NULL);
+		}
+	}
+}
+
+/**
+ * glista_reminder_dispatch_done_cb:
+ * @data Time the delivery took, in milliseconds
+ * 
+ * Called on the main thread once the dispatch thread delivered a batch. If 
+ * due reminders were held back because too many batches were pending, they 
+ * are dispatched now.
+ * 
+ * Returns: FALSE, so that the idle source is removed
+ */
+static gboolean
+glista_reminder_dispatch_done_cb(gpointer data)
+{
+	guint duration = GPOINTER_TO_UINT(data);
+	
+	if (duration >= GLISTA_REMINDER_SLOW_DELIVERY) {
+		g_warning("Delivering a reminder took %u ms", duration);
+	}
+	
+	dispatch_pending--;
+	
+	if (dispatch_throttled) {
+		dispatch_throttled = FALSE;
+		glista_reminder_check_reminders();
+	}
+	
+	return FALSE;
+}
+
+static void glista_reminder_dispatch(GlistaReminderBatch *batch);
+
+/**
+ * glista_reminder_dispatch_handover_cb:
+ * @data The batch the dispatch thread could not deliver
+ * 
+ * Called on the main thread with a batch the dispatch thread took off the 
+ * queue after the module was swapped for one without a deliver function, so
+ * that it is delivered through the new module instead of being dropped.
+ * 
+ * Returns: FALSE, so that the idle source is removed
+ */
+static gboolean
+glista_reminder_dispatch_handover_cb(gpointer data)
+{
+	glista_reminder_dispatch((GlistaReminderBatch *) data);
+	
+	return glista_reminder_dispatch_done_cb(GUINT_TO_POINTER(0));
+}
+
+/**
+ * glista_reminder_dispatch_thread:
+ * @data Data passed at thread creation time
+ * 
+ * The dispatch thread. Takes batches off the dispatch queue and delivers them
+ * through the module's deliver function, timing each delivery. The main loop
+ * is notified through glista_reminder_dispatch_done_cb().
+ * 
+ * Returns: NULL
+ */
+static gpointer
+glista_reminder_dispatch_thread(gpointer data)
+{
+	GlistaReminderBatch *batch;
+	GTimer              *timer;
+	guint                duration;
+	gboolean             handover;
+	
+	timer = g_timer_new();
+	
+	while (TRUE) {
+		batch = (GlistaReminderBatch *) g_async_queue_pop(dispatch_queue);
+		g_timer_start(timer);
+		
+		g_mutex_lock(dispatch_mutex);
+		handover = (deliver_func == NULL);
+		if (! handover) {
+			glista_reminder_call_reminder_func(deliver_func, batch_func, batch);
+		}
+		g_mutex_unlock(dispatch_mutex);
+		
+		if (handover) {
+			g_idle_add(glista_reminder_dispatch_handover_cb, batch);
+			continue;
+		}
+		
+		duration = (guint) (g_timer_elapsed(timer, NULL) * 1000);
+		glista_reminder_batch_free(batch);
+		
+		g_idle_add(glista_reminder_dispatch_done_cb, 
+		           GUINT_TO_POINTER(duration));
+	}
+	
+	return NULL;
+}
+
+/**
+ * glista_reminder_dispatch:
+ * @batch The batch of notices to deliver, freed by this function
+ * 
+ * Deliver a batch of notices through the reminder module. Batches for modules
+ * with a deliver function are queued for the dispatch thread, which is 
+ * started when first needed. Otherwise, or if the thread can not be started,
+ * the batch is delivered right away. Empty batches are dropped.
+ */
+static void
+glista_reminder_dispatch(GlistaReminderBatch *batch)
+{
+	GError *error = NULL;
+	
+	if (batch->notices->len == 0) {
+		glista_reminder_batch_free(batch);
+		return;
+	}
+	
+	if (batch->notices->len > 1 && batch->summary == NULL) {
+		glista_reminder_batch_summarize(batch);
+	}
+	
+	if (deliver_func != NULL && dispatch_thread == NULL) {
+		dispatch_queue = g_async_queue_new();
+		dispatch_mutex = g_mutex_new();
+		dispatch_thread = g_thread_create(glista_reminder_dispatch_thread, 
+		                                  NULL, FALSE, &error);
+		if (dispatch_thread == NULL) {
+			g_warning("Unable to start reminder dispatch thread, "
+			          "delivering synchronously: %s", error->message);
+			g_error_free(error);
+		}
+	}
+	
+	if (deliver_func != NULL && dispatch_thread != NULL) {
+		dispatch_pending++;
+		g_async_queue_push(dispatch_queue, batch);
+		return;
+	}
+	
+	if (remind_func != NULL || deliver_func != NULL) {
+		glista_reminder_call_reminder_func(
+			(remind_func != NULL ? remind_func : deliver_func), batch_func, 
+			batch);
+	}
+	
+	glista_reminder_batch_free(batch);
+}
+
+/**
+ * glista_reminder_check_reminders:
+ * 
+ * Called when the deadline timer expires to check if any reminders are due -
+ * and if so, will dispatch notices for them and then remove them from the 
+ * queue. Due reminders set for times within the configured batch window of 
+ * each other are delivered together, as a single batch. The timer is then 
+ * armed for the next reminder, if any. While too many batches are waiting to
+ * be delivered, due reminders are left in the queue, and are checked again 
+ * once a batch was delivered.
+ * 
+ * Reminders which were missed, because Glista was not running or the system
+ * was suspended, are handled according to the configured catch-up policy: 
+ * delivered like any other reminder, all in a single digest, or only the 
+ * latest one. After the list is loaded, missed reminders are held back for a 
+ * while, see glista_reminder_catchup_delay().
+ */
+static void
+glista_reminder_check_reminders()
+{
+	GlistaReminder       *reminder;
+	GlistaReminderBatch  *batch = NULL, *catchup = NULL, **target;
+	GlistaReminderNotice *notice;
+	time_t                now, batch_start = 0;
+	guint                 policy;
+	
+	// Reminders are not in order while the queue is frozen. The timer is 
+	// armed again once the queue is thawed.
+	if (reminders_frozen > 0) {
+		return;
+	}
+	
+	// Due reminders wait for the first module to be loaded, which checks 
+	// them again once it is installed
+	if (remind_module == NULL && rem_module_loading) {
+		return;
+	}
+	
+	policy = gl_globs->config->reminder_catchup;
+	
+	// Release reminders delivered too long ago to be snoozed
+	if (rem_parked != NULL) {
+		time(&now);
+		g_hash_table_foreach_remove(rem_parked, 
+			(GHRFunc) glista_reminder_parked_expired, &now);
+	}
+	
+	while (reminders != NULL && reminders->len > 0) {
+		// Find the current time and compare to first reminder
+		time(&now);
+		reminder = REMINDER_AT(0);
+		
+		// Hold reminders back until the catch-up delay is over
+		if (now < rem_catchup_at) {
+			break;
+		}
+		
+		if (now >= reminder->remind_at) {	
+			GtkTreeIter  iter;
+			gboolean     is_done;
+			
+			if (policy != GLISTA_REMINDER_CATCHUP_ALL && 
+			    now - reminder->remind_at > GLISTA_REMINDER_CATCHUP_GRACE) {
+				// Missed reminders all go in the catch-up batch
+				target = &catchup;
+				
+			} else {
+				// A reminder too far from the first one in the batch starts
+				// a new batch
+				if (batch != NULL && reminder->remind_at - batch_start > 
+				    (time_t) gl_globs->config->reminder_batch_window) {
+					glista_reminder_dispatch(batch);
+					batch = NULL;
+				}
+				
+				target = &batch;
+				batch_start = (batch == NULL ? reminder->remind_at : 
+				                               batch_start);
+			}
+			
+			if (*target == NULL) {
+				// Hold due reminders back until pending batches are delivered
+				if (dispatch_pending >= GLISTA_REMINDER_DISPATCH_MAX) {
+					dispatch_throttled = TRUE;
+					break;
+				}
+				
+				*target = glista_reminder_batch_new();
+			}
+			
+			// Remove reminder from the queue
+			glista_reminder_queue_remove(reminder);
+			
+			if (glista_item_get_iter(reminder->item_id, &iter)) {
+				gtk_tree_model_get(GL_ITEMSTM, &iter, 
+				                   GL_COLUMN_DONE, &is_done, -1);
+				
+				// Remind
+				if (! is_done) {
+					notice = glista_reminder_notice_new(reminder, &iter);
+					
+					// Reminders are due in order, so the last one missed 
+					// replaces any earlier ones
+					if (target == &catchup && 
+					    policy == GLISTA_REMINDER_CATCHUP_LATEST && 
+					    catchup->notices->len > 0) {
+						glista_reminder_notice_free(
+							g_ptr_array_index(catchup->notices, 0));
+						g_ptr_array_index(catchup->notices, 0) = notice;
+					} else {
+						g_ptr_array_add((*target)->notices, notice);
+					}
+				}
+				
+				if (reminder->repeat != GLISTA_REPEAT_NONE) {
+					// Queue the next occurrence, and touch the item so that
+					// the new reminder time is saved
+					reminder->remind_at = 
+						glista_reminder_next_occurrence(reminder, now);
+					glista_reminder_queue_add(reminder);
+					glista_item_store_set(gl_globs->itemstore, &iter, 
+					                      GL_COLUMN_REMINDER, reminder, -1);
+					continue;
+				}
+				
+				// Clear reminder from item, and keep it in case it is snoozed
+				glista_item_store_set(gl_globs->itemstore, &iter, 
+				                      GL_COLUMN_REMINDER, NULL, -1);
+				
+				if (! is_done) {
+					glista_reminder_park(reminder, now);
+					continue;
+				}
+			}
+			
+			glista_reminder_free(reminder);
+			
+		} else {
+			// If the first reminder is not due yet, break.
+			break;
+		}
+	}
+	
+	if (catchup != NULL) {
+		glista_reminder_dispatch(catchup);
+	}
+	
+	if (batch != NULL) {
+		glista_reminder_dispatch(batch);
+	}
+	
+	// While throttled, the queue is checked again once a batch is delivered
+	if (! dispatch_throttled) {
+		glista_reminder_schedule();
+	}
+}
+
+/**
+ * glista_reminder_remove:
+ * @reminder Reminder to clear out
+ * 
+ * Remove an existing reminder from the reminders queue and free it.
+ */
+void 
+glista_reminder_remove(GlistaReminder *reminder)
+{
+	glista_reminder_queue_remove(reminder);
+	glista_reminder_free(reminder);
+	glista_reminder_schedule();
+}
+
+void 
+glista_reminder_remove_selected()
+{
+	GlistaBatch *batch;
+	GList       *iters, *node;
+	
+	batch = glista_batch_new();
+	iters = glista_list_get_selected_iters();
+	
+	for (node = iters; node != NULL; node = node->next) {
+		glista_batch_set_reminder(batch, (GtkTreeIter *) node->data, -1, NULL);
+		g_free(node->data);
+	}
+	
+	g_list_free(iters);
+	glista_batch_commit(batch);
+}
+
+/**
+ * glista_reminder_set:
+ * @item_id   The ID of the item to set a reminder on
+ * @remind_at The time to remind at
+ * @repeat    Recurrence rule, or NULL if the reminder does not repeat
+ * 
+ * Set a new reminder for an item.
+ * 
+ * If this is the first reminder due, the deadline timer is armed for it.
+ */
+void
+glista_reminder_set(guint64 item_id, time_t remind_at, const gchar *repeat)
+{
+	GlistaReminder *reminder;
+	GtkTreeIter     iter;
+	
+	if (glista_item_get_iter(item_id, &iter)) {
+				
+		// Check if the item is a category - if so set on all children
+		if (gtk_tree_model_iter_has_child(GL_ITEMSTM, &iter)) {
+			glista_reminder_set_category(&iter, remind_at, repeat);
+			return;
+		}
+
+		// Create a new GlistaReminder struct
+		reminder = glista_reminder_new(item_id, remind_at, repeat);
+		glista_reminder_queue_add(reminder);
+		
+		// Set the item "reminder" column to point to the reminder object
+		glista_item_store_set(gl_globs->itemstore, &iter, 
+		                      GL_COLUMN_REMINDER, (gpointer) reminder, -1);
+		
+		// Make sure the timer expires in time for this reminder
+		glista_reminder_schedule();
+	}
+}
+
+/**
+ * glista_reminder_set_category:
+ * @category  Iterator pointing to the category
+ * @remind_at The time to remind at, or -1 to clear reminders
+ * @repeat    Recurrence rule, or NULL if the reminders do not repeat
+ * 
+ * Set the same reminder on all items in a category, replacing any reminders
+ * they already have, in a single pass over the category. The queue is frozen
+ * meanwhile, so that it is rebuilt once instead of sifting each reminder, and
+ * the deadline timer is armed once. The reminders come due together, and are
+ * delivered as one batch.
+ */
+void
+glista_reminder_set_category(GtkTreeIter *category, time_t remind_at,
+                             const gchar *repeat)
+{
+	GlistaReminder *reminder;
+	GtkTreeIter     child;
+	guint64         child_id;
+	
+	if (! gtk_tree_model_iter_children(GL_ITEMSTM, &child, category)) {
+		return;
+	}
+	
+	glista_reminder_queue_freeze();
+	
+	do {
+		gtk_tree_model_get(GL_ITEMSTM, &child, GL_COLUMN_REMINDER, &reminder,
+		                                       GL_COLUMN_ID, &child_id, -1);
+		
+		// Drop the current reminder, if any
+		if (reminder != NULL) {
+			glista_reminder_queue_remove(reminder);
+			glista_reminder_free(reminder);
+			reminder = NULL;
+		}
+		
+		if (remind_at != -1) {
+			reminder = glista_reminder_new(child_id, remind_at, repeat);
+			glista_reminder_queue_add(reminder);
+		}
+		
+		glista_item_store_set(gl_globs->itemstore, &child, 
+		                      GL_COLUMN_REMINDER, (gpointer) reminder, -1);
+		
+	} while (gtk_tree_model_iter_next(GL_ITEMSTM, &child));
+	
+	glista_reminder_queue_thaw();
+}
+
+/**
+ * glista_reminder_set_on_selected:
+ * @remind_at Time to remind at
+ * @repeat    Recurrence rule, or NULL if the reminders do not repeat
+ * 
+ * Set reminders at the specified time on all currently selected items, in a
+ * single batch. Existing reminders on these items are replaced.
+ */
+void
+glista_reminder_set_on_selected(time_t remind_at, const gchar *repeat)
+{
+	GlistaBatch *batch;
+	GList       *iters, *node;
+	
+	batch = glista_batch_new();
+	iters = glista_list_get_selected_iters();
+	
+	// Iterate over the selected rows, and set a reminder
+	for (node = iters; node != NULL; node = node->next) {
+		glista_batch_set_reminder(batch, (GtkTreeIter *) node->data, remind_at,
+		                          repeat);
+		g_free(node->data);
 	}
 	
-	// Free reference list
-    g_list_free(ref_list);
+	g_list_free(iters);
+	glista_batch_commit(batch);
 }
 
 /**
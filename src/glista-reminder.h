@@ -25,10 +25,65 @@
 #include <time.h>
 #include <gtk/gtk.h>
 
-#ifndef GLISTA_REMINDER_INTERVAL
-#define GLISTA_REMINDER_INTERVAL 3
+// Longest time to sleep between reminder checks, in seconds, if the system 
+// clock can not be watched for changes
+#ifndef GLISTA_REMINDER_MAX_SLEEP
+#define GLISTA_REMINDER_MAX_SLEEP 60
 #endif 
 
+// Most due reminders waiting to be delivered. Further due reminders are held
+// back in the queue until earlier ones were delivered.
+#ifndef GLISTA_REMINDER_DISPATCH_MAX
+#define GLISTA_REMINDER_DISPATCH_MAX 16
+#endif
+
+// Deliveries taking longer than this, in milliseconds, are logged as slow
+#ifndef GLISTA_REMINDER_SLOW_DELIVERY
+#define GLISTA_REMINDER_SLOW_DELIVERY 1000
+#endif
+
+// Default time, in seconds, within which due reminders are delivered together
+#ifndef GLISTA_REMINDER_BATCH_WINDOW
+#define GLISTA_REMINDER_BATCH_WINDOW 60
+#endif
+
+// Reminders due more than this many seconds ago were missed, and are handled
+// according to the catch-up policy
+#ifndef GLISTA_REMINDER_CATCHUP_GRACE
+#define GLISTA_REMINDER_CATCHUP_GRACE 120
+#endif
+
+// Seconds to hold reminders back for after the list is loaded
+#ifndef GLISTA_REMINDER_CATCHUP_DELAY
+#define GLISTA_REMINDER_CATCHUP_DELAY 10
+#endif
+
+// Default time, in seconds, to snooze a reminder for
+#ifndef GLISTA_REMINDER_SNOOZE
+#define GLISTA_REMINDER_SNOOZE 600
+#endif
+
+// Seconds after delivery during which a reminder can still be snoozed
+#ifndef GLISTA_REMINDER_SNOOZE_EXPIRY
+#define GLISTA_REMINDER_SNOOZE_EXPIRY 86400
+#endif
+
+// Consecutive failed deliveries after which the default module is used
+#ifndef GLISTA_REMINDER_MODULE_FAILURES
+#define GLISTA_REMINDER_MODULE_FAILURES 3
+#endif
+
+// Milliseconds to wait before installing a module again, if the current 
+// module is busy delivering
+#ifndef GLISTA_REMINDER_MODULE_RETRY
+#define GLISTA_REMINDER_MODULE_RETRY 100
+#endif
+
+// Number of items listed in the summary of a batch of due reminders
+#ifndef GLISTA_REMINDER_SUMMARY_ITEMS
+#define GLISTA_REMINDER_SUMMARY_ITEMS 5
+#endif
+
 #ifndef GLISTA_REMINDER_TIME_STRLEN
 #define GLISTA_REMINDER_TIME_STRLEN 100
 #endif
@@ -37,26 +92,97 @@
 #define GLISTA_REMINDER_TIME_FORMAT "%c"
 #endif
 
+/**
+ * Recurrence rules. Rules are stored as short strings: "daily", "weekdays", 
+ * "hours:N" (every N hours) or "monthly:D" (on day D of every month). Only the
+ * next occurrence of a recurring reminder is queued, and the one after it is
+ * computed when it is due.
+ */
+
+#define GLISTA_REPEAT_RULE_DAILY    "daily"
+#define GLISTA_REPEAT_RULE_WEEKDAYS "weekdays"
+#define GLISTA_REPEAT_RULE_HOURS    "hours"
+#define GLISTA_REPEAT_RULE_MONTHLY  "monthly"
+
+typedef enum {
+	GLISTA_REPEAT_NONE,
+	GLISTA_REPEAT_DAILY,
+	GLISTA_REPEAT_WEEKDAYS,
+	GLISTA_REPEAT_HOURS,
+	GLISTA_REPEAT_MONTHLY
+} GlistaReminderRepeat;
+
+/**
+ * Catch-up policies for missed reminders
+ */
+
+typedef enum {
+	GLISTA_REMINDER_CATCHUP_ALL,    // Deliver like any other reminder
+	GLISTA_REMINDER_CATCHUP_DIGEST, // Deliver all in a single batch
+	GLISTA_REMINDER_CATCHUP_LATEST  // Deliver the latest one only
+} GlistaReminderCatchup;
+
 /**
  * Reminder struct 
  */
 
 typedef struct _glista_reminder_struct {
-	GtkTreeRowReference *item_ref;
+	guint64              item_id;
 	time_t               remind_at;
+	guint                heap_index; // Position in the reminders queue
+	GlistaReminderRepeat repeat;     // Recurrence rule
+	guint                repeat_arg; // Hours between occurrences, or day of 
+	                                 // month to repeat on
 } GlistaReminder;
 
+/**
+ * Reminder notice: everything a remind handler needs to know about a due 
+ * reminder, copied from the list when it is due. Handlers get a notice 
+ * instead of the reminder, so that they never need to access the list.
+ */
+
+typedef struct _glista_reminder_notice_struct {
+	guint64  item_id;
+	gchar   *text;
+	gchar   *category;  // NULL if the item is not in a category
+	time_t   remind_at;
+} GlistaReminderNotice;
+
+/**
+ * Batch of reminder notices due together
+ */
+
+typedef struct _glista_reminder_batch_struct {
+	GPtrArray *notices;  // GlistaReminderNotice pointers, in reminder order
+	gchar     *summary;  // One line summary of all notices in the batch
+} GlistaReminderBatch;
+
 /**
  * Public function signatures 
  */
 
-void   glista_reminder_set(GtkTreeRowReference *item_ref, 
-                           time_t remind_at);
+void   glista_reminder_set(guint64 item_id, time_t remind_at, 
+                           const gchar *repeat);
+
+void   glista_reminder_set_category(GtkTreeIter *category, time_t remind_at,
+                                    const gchar *repeat);
                          
-void   glista_reminder_set_on_selected(time_t remind_at);
+void   glista_reminder_set_on_selected(time_t remind_at, const gchar *repeat);
+
+gchar* glista_reminder_get_repeat(GlistaReminder *reminder);
 
 void   glista_reminder_remove(GlistaReminder *reminder);
 
+void   glista_reminder_queue_freeze();
+
+void   glista_reminder_queue_thaw();
+
+void   glista_reminder_catchup_delay(guint seconds);
+
+void   glista_reminder_snooze(guint64 item_id, guint seconds);
+
+void   glista_reminder_set_module(const gchar *mod_name);
+
 void   glista_reminder_shutdown();
 
 void   glista_reminder_free(GlistaReminder *reminder);
@@ -69,14 +195,25 @@ gchar* glista_reminder_time_as_string(GlistaReminder *reminder,
 void   glista_reminder_remove_selected();
 
 /**
- * Function signatures for reminderhandler modules 
+ * Function signatures for reminderhandler modules. A module implements either
+ * glista_remindhandler_remind(), which is called on the main thread, or 
+ * glista_remindhandler_deliver(), which is called on the reminder dispatch 
+ * thread and may block, but must not call GTK+.
+ * 
+ * Due reminders are delivered in batches. Modules may implement 
+ * glista_remindhandler_remind_batch() or glista_remindhandler_deliver_batch()
+ * respectively, to deliver a batch of more than one notice at once. Otherwise
+ * the batch summary is delivered as a single notice.
  */
 
 typedef gboolean (* GlistaRHInitFuc) (GError **error);
 
-typedef gboolean (* GlistaRHRemindFunc) (GlistaReminder *reminder, 
+typedef gboolean (* GlistaRHRemindFunc) (GlistaReminderNotice *notice, 
                                          GError **error);
 
+typedef gboolean (* GlistaRHRemindBatchFunc) (GlistaReminderBatch *batch, 
+                                              GError **error);
+
 typedef gboolean (* GlistaRHShutdownFunc) (GError **error);
 
 /**
@@ -0,0 +1,1637 @@
+/**
+ * Glista - A simple task list management utility
+ * Copyright (C) 2008 Shahar Evron, shahar@prematureoptimization.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _XOPEN_SOURCE /* glibc2 needs this */
+#include <time.h>
+#include <glib.h>
+#include <libxml/xmlreader.h>
+#include <libxml/xmlwriter.h>
+#include <glib/gstdio.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "glista.h"
+#include "glista-storage.h"
+
+/**
+ * Glista XML Storage Backend
+ * 
+ * The default, built-in storage backend. Items are stored in a full XML 
+ * snapshot, plus an append-only journal of the changes made since the 
+ * snapshot was written. Each save only appends the records of the items the
+ * list reports as deleted or inserted (an updated item is a delete followed 
+ * by an insert). Once the journal grows past GL_JOURNAL_COMPACT_RECORDS 
+ * records, the snapshot and the journal are read back and compacted into a 
+ * new snapshot.
+ *
+ * Snapshots are written to a temporary file which is synced to disk and then
+ * renamed over the previous snapshot, so a crash never leaves a truncated 
+ * snapshot behind. The previous GL_XML_BACKUPS snapshots are kept, and are
+ * loaded if the current snapshot is damaged.
+ *
+ * Whenever a snapshot is written, a binary copy of it is written next to it.
+ * The binary snapshot is memory-mapped on startup, and items point directly
+ * into it, so loading does not need to parse XML or allocate any strings. 
+ * Items are handed to the caller in batches, as they are read. If
+ * the binary snapshot is missing or does not match the XML file, the XML file
+ * is loaded instead.
+ */
+
+/**
+ * Binary snapshot header
+ */
+typedef struct {
+	gchar   magic[4];   // GL_BINARY_MAGIC
+	guint32 version;    // GL_BINARY_VERSION
+	guint32 byte_order; // GL_BINARY_BYTEORDER, in the writer's byte order
+	guint32 generation; // Snapshot generation
+	guint32 count;      // Number of item records
+	guint32 pool_size;  // Size of the string pool, in bytes
+	guint64 xml_size;   // Size of the XML snapshot this was written with
+	gint64  xml_mtime;  // Modification time of the same XML snapshot
+} GlistaBinaryHeader;
+
+/**
+ * Binary snapshot item record. Strings are offsets into the string pool, 
+ * which follows the record table, or GL_BINARY_NULL if not set.
+ */
+typedef struct {
+	guint64 id;
+	gint64  remind_at;
+	guint32 text;
+	guint32 parent;
+	guint32 note;
+	guint32 done;
+	guint32 repeat;
+} GlistaBinaryRecord;
+
+/**
+ * Binary snapshot being built
+ */
+typedef struct {
+	GlistaBinaryHeader  header;
+	GString            *contents; // Header and record table
+	GString            *pool;     // String pool
+	GHashTable         *offsets;  // Offsets of strings already in the pool
+} GlistaBinaryWriter;
+
+/**
+ * Loader state, kept between batches of loaded items
+ */
+typedef struct {
+	GlistaStorageLoadFunc  func;      // Load callback of the current batch
+	gpointer               user_data; // User data to pass to @func
+	GHashTable            *deleted;   // Snapshot items deleted by the journal
+	GList                 *inserted;  // Items inserted by the journal
+	GMappedFile           *mapped;    // Binary snapshot being read, if any
+	guint                  position;  // Next record in the binary snapshot
+	xmlTextReaderPtr       xml;       // XML snapshot being read, if any
+	GlistaBinaryWriter    *binary;    // Binary snapshot written while loading
+} GlistaXmlLoader;
+
+/**
+ * Generation of the current snapshot. The journal is tagged with the
+ * generation it applies to, so a stale journal is never replayed on top of a
+ * newer snapshot.
+ */
+static guint snapshot_generation = 0;
+
+/**
+ * Number of records in the journal since the snapshot was written
+ */
+static guint journal_records = 0;
+
+/**
+ * Whether the current XML snapshot is missing or damaged, and was not loaded.
+ * If so, the next save writes a new snapshot, and the damaged one is not kept
+ * as a backup.
+ */
+static gboolean snapshot_damaged = FALSE;
+
+/**
+ * Characters not to escape when writing strings to the journal - we only need
+ * to escape ASCII control characters, so UTF-8 text is kept as is
+ */
+static gchar *journal_escape_exceptions = NULL;
+
+/**
+ * load_string:
+ * @str Newly allocated string read from storage, may be NULL
+ *
+ * Empty strings are stored for unset fields, so free them
+ *
+ * Returns: @str, or NULL if @str is NULL or empty
+ */
+static gchar*
+load_string(gchar *str)
+{
+	if (str != NULL && *str == '\0') {
+		g_free(str);
+		str = NULL;
+	}
+	
+	return str;
+}
+
+/**
+ * load_item_free:
+ * @item Item read from storage
+ *
+ * Free an item read from storage, including all its strings
+ */
+static void
+load_item_free(GlistaItem *item)
+{
+	g_free(item->text);
+	g_free(item->parent);
+	g_free(item->note);
+	g_free(item->repeat);
+	g_free(item);
+}
+
+/**
+ * read_next_text_node:
+ * @xml XML reader
+ * 
+ * Read the text value of the next node, assuming that it is a text node. If no
+ * text node value is encountered before the tag ends, will return NULL
+ * 
+ * Returns: text read from node value or NULL if none
+ */
+static gchar*
+read_next_text_node(xmlTextReaderPtr xml)
+{
+	gchar    *text = NULL;
+	gboolean  text_done = FALSE;
+	
+	while ((! text_done) && xmlTextReaderRead(xml) == 1) {
+		switch(xmlTextReaderNodeType(xml)) {
+			case 3: // Text node, read value
+				text = (gchar *) xmlTextReaderValue(xml);
+				g_strstrip(text);
+				text_done = TRUE;
+				break;
+				
+			case 15: // End node - no text
+				text_done = TRUE;
+				break;
+		}
+	}
+	
+	return text;
+}
+
+/**
+ * read_next_item: 
+ * @xml XML reader
+ * 
+ * Read the next item from the XML file and populate it's properties
+ * 
+ * Returns: a newly created GlistaItem or NULL if nothing more to read
+ */
+static GlistaItem*
+read_next_item(xmlTextReaderPtr xml) 
+{
+	gchar      *text, *done, *parent, *note, *remind_at_str;
+	xmlChar    *node_name, *id, *repeat;
+	gboolean    item_done;
+	GlistaItem *item;
+	
+	item          = NULL;
+	text          = NULL;
+	done          = NULL;
+	parent        = NULL;
+	note          = NULL;
+	remind_at_str = NULL;
+	item_done     = FALSE;
+	
+	while ((! item_done) && xmlTextReaderRead(xml) == 1) {
+		node_name = xmlTextReaderName(xml);
+		
+		if (xmlStrEqual(node_name, BAD_CAST GL_XNODE_ITEM) && 
+		    xmlTextReaderNodeType(xml) == 1) {
+		    
+		    // Create item
+		    item = glista_item_new(NULL, NULL);
+		    
+		    // Read item ID, if any. Items stored before IDs were introduced 
+		    // get a new ID when added to the list.
+		    id = xmlTextReaderGetAttribute(xml, BAD_CAST GL_XATTR_ID);
+		    if (id != NULL) {
+		    	item->id = g_ascii_strtoull((gchar *) id, NULL, 10);
+		    	xmlFree(id);
+		    }
+		    
+		    // Read item data
+		    while ((! item_done) && xmlTextReaderRead(xml) == 1) {
+		    	xmlFree(node_name);		    		
+		    	node_name = xmlTextReaderName(xml);
+				
+				// Node text
+				if (xmlStrEqual(node_name, BAD_CAST GL_XNODE_TEXT)) {
+					if (text == NULL) {
+						text = read_next_text_node(xml);
+					}
+					
+				} else 
+				
+				// Node 'done' flag
+				if (xmlStrEqual(node_name, BAD_CAST GL_XNODE_DONE)) {
+					if (done == NULL) {
+						done = read_next_text_node(xml);
+					}
+					
+				} else 
+				
+				// Node parent
+				if (xmlStrEqual(node_name, BAD_CAST GL_XNODE_PRNT)) {
+					if (parent == NULL) {
+						parent = read_next_text_node(xml);
+					}
+					
+				} else 
+				
+				// Node item note
+				if (xmlStrEqual(node_name, BAD_CAST GL_XNODE_NOTE)) {
+					if (note == NULL) {
+						note = read_next_text_node(xml);
+					}
+					
+				} else 
+				
+				// Node reminder
+				if (xmlStrEqual(node_name, BAD_CAST GL_XNODE_RMDR)) {
+					if (remind_at_str == NULL) {
+						// Read the recurrence rule, if any
+						repeat = xmlTextReaderGetAttribute(xml, 
+						                                BAD_CAST GL_XATTR_RPT);
+						if (repeat != NULL) {
+							g_free(item->repeat);
+							item->repeat = g_strdup((gchar *) repeat);
+							xmlFree(repeat);
+						}
+						
+						remind_at_str = read_next_text_node(xml);
+					}
+					
+				} else 
+				
+				if (xmlStrEqual(node_name, BAD_CAST GL_XNODE_ITEM) && 
+				    xmlTextReaderNodeType(xml) == 15) {
+				    	
+				    item_done = TRUE;
+				}
+			}
+			
+			// Set the text, if not empty
+			item->text = load_string(text);
+			
+			// Set "done" flag
+			if (done != NULL) {
+				if (*done == '1') {
+					item->done = TRUE;	
+				}
+				g_free(done);
+			}
+				
+			
+			// Set the parent and note, if any
+			item->parent = load_string(parent);
+			item->note   = load_string(note);
+			
+			// Set the reminder time, if set
+			if (remind_at_str != NULL) {
+				if (strlen(remind_at_str) > 0) {
+					item->remind_at = (time_t) atoi(remind_at_str);
+				}
+				
+				g_free(remind_at_str);
+			}
+		}
+		
+		xmlFree(node_name);
+	}
+
+	return item;
+}
+
+/**
+ * journal_escape:
+ * @str String to escape, may be NULL
+ *
+ * Escape a string so it can be written as a single journal field
+ *
+ * Returns: a newly allocated escaped string
+ */
+static gchar*
+journal_escape(const gchar *str)
+{
+	gint i;
+	
+	if (str == NULL) {
+		return g_strdup("");
+	}
+	
+	// Build the list of exceptions (all non-ASCII bytes) once
+	if (journal_escape_exceptions == NULL) {
+		journal_escape_exceptions = g_malloc(129);
+		for (i = 0; i < 128; i++) {
+			journal_escape_exceptions[i] = (gchar) (i + 128);
+		}
+		journal_escape_exceptions[128] = '\0';
+	}
+	
+	return g_strescape(str, journal_escape_exceptions);
+}
+
+/**
+ * journal_write_insert:
+ * @records Buffer of journal records to append to
+ * @item    The inserted item
+ *
+ * Append an "insert" record, containing all the item data, to @records
+ */
+static void
+journal_write_insert(GString *records, GlistaItem *item)
+{
+	gchar *text, *parent, *note, *repeat;
+	
+	text   = journal_escape(item->text);
+	parent = journal_escape(item->parent);
+	note   = journal_escape(item->note);
+	repeat = journal_escape(item->repeat);
+	
+	g_string_append_printf(records, 
+	                       "%c\t%d\t%ld\t%s\t%s\t%s\t%" G_GUINT64_FORMAT 
+	                       "\t%s\n", 
+	                       GL_JOURNAL_INSERT, (item->done ? 1 : 0), 
+	                       (glong) item->remind_at, text, parent, note, 
+	                       item->id, repeat);
+	
+	g_free(text);
+	g_free(parent);
+	g_free(note);
+	g_free(repeat);
+}
+
+/**
+ * journal_write_delete:
+ * @records Buffer of journal records to append to
+ * @hash    Content hash of the deleted item
+ *
+ * Append a "delete" record to @records. Deleted items are identified by their
+ * content hash.
+ */
+static void
+journal_write_delete(GString *records, guint64 hash)
+{
+	g_string_append_printf(records, "%c\t%016" G_GINT64_MODIFIER "x\n", 
+	                       GL_JOURNAL_DELETE, hash);
+}
+
+/**
+ * journal_read_insert:
+ * @fields The fields of an insert record
+ *
+ * Create an item from the fields of an "insert" journal record. Records 
+ * written before item IDs were introduced have no ID field, and records 
+ * written before recurring reminders have no recurrence rule field.
+ *
+ * Returns: a newly created GlistaItem or NULL if record has no text
+ */
+static GlistaItem*
+journal_read_insert(gchar **fields)
+{
+	GlistaItem *item;
+	gchar      *text;
+	
+	if ((text = load_string(g_strcompress(fields[3]))) == NULL) {
+		return NULL;
+	}
+	
+	item = glista_item_new(text, NULL);
+	item->done      = (*fields[1] == '1');
+	item->remind_at = (time_t) g_ascii_strtoll(fields[2], NULL, 10);
+	item->parent    = load_string(g_strcompress(fields[4]));
+	item->note      = load_string(g_strcompress(fields[5]));
+	
+	if (fields[6] != NULL) {
+		item->id = g_ascii_strtoull(fields[6], NULL, 10);
+		
+		if (fields[7] != NULL) {
+			item->repeat = load_string(g_strcompress(fields[7]));
+		}
+	}
+	
+	return item;
+}
+
+/**
+ * glista_storage_journal_read:
+ * @deleted Hash table to populate with the number of snapshot items deleted
+ *          by the journal, keyed by content hash
+ * 
+ * Read all changes recorded in the journal. Items deleted by the journal are
+ * counted in @deleted, so that they can be skipped while the snapshot is 
+ * loaded. If the journal does not belong to the current snapshot generation 
+ * it is ignored. A journal of a newer generation than the snapshot, which is
+ * the case after falling back to a backup copy, holds changes which can not
+ * be replayed: it is moved aside so they are not overwritten, with a warning.
+ *
+ * Returns: List of items inserted by the journal and not deleted since
+ */
+static GList*
+glista_storage_journal_read(GHashTable *deleted)
+{
+	gchar       *journal_file, *lost_file, *contents, **lines, **fields;
+	GHashTable  *index;
+	GList       *node, *next, *inserted = NULL;
+	GlistaItem  *item;
+	GQueue      *items;
+	guint64      hash, *key, generation;
+	guint        count;
+	gint         i;
+	
+	journal_records = 0;
+	journal_file = g_build_filename(gl_globs->configdir, GL_JOURNAL_FILENAME, 
+	                                NULL);
+	
+	if (! g_file_get_contents(journal_file, &contents, NULL, NULL)) {
+		g_free(journal_file);
+		return NULL;
+	}
+	
+	lines = g_strsplit(contents, "\n", -1);
+	g_free(contents);
+	
+	// First line tells us which snapshot this journal belongs to
+	if (lines[0] == NULL || lines[0][0] != '#') {
+		g_free(journal_file);
+		g_strfreev(lines);
+		return NULL;
+	}
+	
+	generation = g_ascii_strtoull(lines[0] + 1, NULL, 10);
+	if (generation != snapshot_generation) {
+		for (count = 0; lines[count + 1] != NULL && 
+		                lines[count + 2] != NULL; count++);
+		
+		if (generation > snapshot_generation && count > 0) {
+			lost_file = g_strconcat(journal_file, GL_JOURNAL_LOST_SUFFIX, 
+			                        NULL);
+			
+			if (g_rename(journal_file, lost_file) == 0) {
+				g_warning("Storage journal belongs to a newer snapshot than "
+				          "the one loaded, %u changes were not loaded and "
+				          "were kept in %s", count, lost_file);
+			} else {
+				g_warning("Storage journal belongs to a newer snapshot than "
+				          "the one loaded, %u changes were not loaded", count);
+			}
+			
+			g_free(lost_file);
+		}
+		
+		g_free(journal_file);
+		g_strfreev(lines);
+		return NULL;
+	}
+	
+	g_free(journal_file);
+	
+	// Index inserted items by their content hash
+	index = glista_storage_hash_table_new((GDestroyNotify) g_queue_free);
+	
+	// Replay records. A record is only complete if a newline follows it, so
+	// the last line (which is empty or half-written) is never replayed.
+	for (i = 1; lines[i] != NULL && lines[i + 1] != NULL; i++) {
+		// Insert records have up to 8 fields: type, done, remind_at, text, 
+		// parent, note, id and repeat rule
+		fields = g_strsplit(lines[i], "\t", 8);
+		
+		if (fields[0] != NULL && fields[0][0] == GL_JOURNAL_INSERT && 
+		    g_strv_length(fields) >= 6) {
+			
+			if ((item = journal_read_insert(fields)) != NULL) {
+				inserted = g_list_prepend(inserted, item);
+				glista_storage_hash_table_queue(index, glista_storage_item_hash(item), 
+				                      item);
+			}
+			
+			journal_records++;
+			
+		} else if (fields[0] != NULL && fields[0][0] == GL_JOURNAL_DELETE && 
+		           g_strv_length(fields) == 2) {
+			
+			// Items with the same hash are identical, so we delete one that
+			// was inserted by the journal if there is one, and an item from 
+			// the snapshot otherwise
+			hash = g_ascii_strtoull(fields[1], NULL, 16);
+			items = g_hash_table_lookup(index, &hash);
+			if (items != NULL && (item = g_queue_pop_head(items)) != NULL) {
+				g_free(item->text);
+				item->text = NULL;
+				
+			} else {
+				key = g_new(guint64, 1);
+				*key = hash;
+				count = GPOINTER_TO_UINT(g_hash_table_lookup(deleted, key));
+				g_hash_table_replace(deleted, key, GUINT_TO_POINTER(count + 1));
+			}
+			
+			journal_records++;
+		}
+		
+		g_strfreev(fields);
+	}
+	
+	g_strfreev(lines);
+	g_hash_table_destroy(index);
+	
+	// Drop deleted items
+	inserted = g_list_reverse(inserted);
+	for (node = inserted; node != NULL; node = next) {
+		next = node->next;
+		item = (GlistaItem *) node->data;
+		
+		if (item->text == NULL) {
+			load_item_free(item);
+			inserted = g_list_delete_link(inserted, node);
+		}
+	}
+	
+	return inserted;
+}
+
+/**
+ * glista_storage_journal_append:
+ * @records Journal records to append
+ * @error   A pointer to fill with an error, if any
+ *
+ * Append records to the journal file. If the journal is empty, a new journal
+ * is started for the current snapshot generation.
+ *
+ * Returns: TRUE on success, FALSE otherwise
+ */
+static gboolean
+glista_storage_journal_append(GString *records, GError **error)
+{
+	gchar    *journal_file;
+	FILE     *journal;
+	gboolean  success = TRUE;
+	
+	journal_file = g_build_filename(gl_globs->configdir, GL_JOURNAL_FILENAME, 
+	                                NULL);
+	
+	journal = g_fopen(journal_file, (journal_records == 0 ? "w" : "a"));
+	g_free(journal_file);
+	
+	if (journal == NULL) {
+		g_set_error(error, GLISTA_STORAGE_ERROR_QUARK, 
+		            GLISTA_STORAGE_ERROR_SAVE, 
+		            "Unable to write data to storage journal file");
+		return FALSE;
+	}
+	
+	if (journal_records == 0) {
+		fprintf(journal, "#%u\n", snapshot_generation);
+	}
+	
+	if (fwrite(records->str, 1, records->len, journal) != records->len ||
+	    fflush(journal) != 0 || fsync(fileno(journal)) != 0) {
+		success = FALSE;
+	}
+	
+	if (fclose(journal) != 0) {
+		success = FALSE;
+	}
+	
+	if (! success) {
+		g_set_error(error, GLISTA_STORAGE_ERROR_QUARK, 
+		            GLISTA_STORAGE_ERROR_SAVE, 
+		            "Error writing to storage journal file");
+	}
+	
+	return success;
+}
+
+/**
+ * glista_storage_xml_file:
+ * @backup Number of the backup copy, or 0 for the current snapshot
+ *
+ * Build the path of the XML snapshot or one of its backup copies
+ *
+ * Returns: Newly allocated path
+ */
+static gchar*
+glista_storage_xml_file(guint backup)
+{
+	gchar *name, *path;
+	
+	if (backup == 0) {
+		return g_build_filename(gl_globs->configdir, GL_XML_FILENAME, NULL);
+	}
+	
+	name = g_strdup_printf("%s.%u", GL_XML_FILENAME, backup);
+	path = g_build_filename(gl_globs->configdir, name, NULL);
+	g_free(name);
+	
+	return path;
+}
+
+/**
+ * glista_storage_xml_check:
+ * @xml_file Path to an XML snapshot
+ *
+ * Check that an XML snapshot can be read, by parsing the whole file. This is
+ * only done when the binary snapshot can not be used, so that a file damaged 
+ * anywhere is never partially loaded while a good backup copy exists.
+ *
+ * Returns: TRUE if the snapshot parses, FALSE if it is missing or damaged
+ */
+static gboolean
+glista_storage_xml_check(const gchar *xml_file)
+{
+	xmlTextReaderPtr  xml;
+	xmlChar          *node_name;
+	gboolean          valid = FALSE;
+	int               ret;
+	
+	xml = xmlReaderForFile(xml_file, GL_XML_ENCODING, 
+	                       XML_PARSE_NOERROR | XML_PARSE_NOWARNING);
+	if (xml == NULL) {
+		return FALSE;
+	}
+	
+	// The root element must be ours, and the rest of the file must parse
+	if ((ret = xmlTextReaderRead(xml)) == 1) {
+		node_name = xmlTextReaderName(xml);
+		valid = xmlStrEqual(node_name, BAD_CAST GL_XNODE_ROOT);
+		xmlFree(node_name);
+		
+		while (valid && (ret = xmlTextReaderRead(xml)) == 1);
+		valid = (valid && ret == 0);
+	}
+	
+	xmlFreeTextReader(xml);
+	
+	return valid;
+}
+
+/**
+ * glista_storage_xml_rotate:
+ *
+ * Keep the current XML snapshot as a backup copy before it is replaced, 
+ * shifting older copies and dropping the oldest one. The current snapshot 
+ * is hard linked, so it stays in place until the new one is renamed over it.
+ */
+static void
+glista_storage_xml_rotate()
+{
+	gchar *from, *to;
+	guint  i;
+	
+	if (GL_XML_BACKUPS == 0) return;
+	
+	for (i = GL_XML_BACKUPS; i > 1; i--) {
+		from = glista_storage_xml_file(i - 1);
+		to   = glista_storage_xml_file(i);
+		
+		// Missing copies are expected until enough snapshots were written
+		g_rename(from, to);
+		
+		g_free(from);
+		g_free(to);
+	}
+	
+	from = glista_storage_xml_file(0);
+	to   = glista_storage_xml_file(1);
+	
+	g_unlink(to);
+	if (link(from, to) != 0 && errno != ENOENT) {
+		g_warning("Unable to keep a backup of the storage XML file: %s", 
+		          g_strerror(errno));
+	}
+	
+	g_free(from);
+	g_free(to);
+}
+
+/**
+ * glista_storage_sync_dir:
+ *
+ * Sync the configuration directory, so that a file just renamed into it is 
+ * on disk as well. Errors are ignored, as not all file systems support this.
+ */
+static void
+glista_storage_sync_dir()
+{
+	int fd;
+	
+	if ((fd = g_open(gl_globs->configdir, O_RDONLY, 0)) != -1) {
+		fsync(fd);
+		close(fd);
+	}
+}
+
+/**
+ * glista_storage_xml_stat:
+ * @xml_file Path to the XML snapshot
+ * @size     Pointer to set to the file size
+ * @mtime    Pointer to set to the file modification time
+ *
+ * Get the size and modification time of the XML snapshot, used to tell 
+ * whether the binary snapshot is stale
+ *
+ * Returns: TRUE on success, FALSE if the file can't be accessed
+ */
+static gboolean
+glista_storage_xml_stat(const gchar *xml_file, guint64 *size, gint64 *mtime)
+{
+	struct stat st;
+	
+	if (g_stat(xml_file, &st) != 0) {
+		return FALSE;
+	}
+	
+	*size  = (guint64) st.st_size;
+	*mtime = (gint64) st.st_mtime;
+	
+	return TRUE;
+}
+
+/**
+ * binary_pool_add:
+ * @writer The binary snapshot writer
+ * @str    String to add, may be NULL
+ *
+ * Add a string to the binary snapshot string pool. Strings already in the 
+ * pool (mostly category names) are only stored once.
+ *
+ * Returns: offset of the string in the pool or GL_BINARY_NULL
+ */
+static guint32
+binary_pool_add(GlistaBinaryWriter *writer, const gchar *str)
+{
+	gpointer offset;
+	
+	if (str == NULL) {
+		return GL_BINARY_NULL;
+	}
+	
+	// Offsets are stored + 1, so that offset 0 is not a NULL pointer
+	if ((offset = g_hash_table_lookup(writer->offsets, str)) == NULL) {
+		offset = GUINT_TO_POINTER(writer->pool->len + 1);
+		g_string_append_len(writer->pool, str, strlen(str) + 1);
+		g_hash_table_insert(writer->offsets, g_strdup(str), offset);
+	}
+	
+	return (guint32) (GPOINTER_TO_UINT(offset) - 1);
+}
+
+/**
+ * binary_pool_get:
+ * @header Binary snapshot header
+ * @pool   Pointer to the string pool
+ * @offset Offset of the string in the pool
+ * @valid  Pointer to a flag to clear if the offset is invalid
+ *
+ * Get a string from the binary snapshot string pool
+ *
+ * Returns: pointer to the string or NULL
+ */
+static gchar*
+binary_pool_get(GlistaBinaryHeader *header, const gchar *pool, guint32 offset,
+                gboolean *valid)
+{
+	if (offset == GL_BINARY_NULL) {
+		return NULL;
+	}
+	
+	if (offset >= header->pool_size) {
+		*valid = FALSE;
+		return NULL;
+	}
+	
+	return (gchar *) pool + offset;
+}
+
+/**
+ * glista_storage_binary_writer_new:
+ * @generation The snapshot generation
+ *
+ * Start building a binary snapshot
+ *
+ * Returns: a newly allocated binary snapshot writer
+ */
+static GlistaBinaryWriter*
+glista_storage_binary_writer_new(guint generation)
+{
+	GlistaBinaryWriter *writer;
+	
+	writer = g_new0(GlistaBinaryWriter, 1);
+	
+	memcpy(writer->header.magic, GL_BINARY_MAGIC, 
+	       sizeof(writer->header.magic));
+	writer->header.version    = GL_BINARY_VERSION;
+	writer->header.byte_order = GL_BINARY_BYTEORDER;
+	writer->header.generation = generation;
+	
+	// The record table is built right after the header, the pool separately
+	writer->contents = g_string_new_len((gchar *) &writer->header, 
+	                                    sizeof(writer->header));
+	writer->pool     = g_string_new(NULL);
+	writer->offsets  = g_hash_table_new_full(g_str_hash, g_str_equal, 
+	                                         g_free, NULL);
+	
+	return writer;
+}
+
+/**
+ * glista_storage_binary_writer_add:
+ * @writer The binary snapshot writer
+ * @item   The item to add
+ *
+ * Add an item to a binary snapshot
+ */
+static void
+glista_storage_binary_writer_add(GlistaBinaryWriter *writer, GlistaItem *item)
+{
+	GlistaBinaryRecord record;
+	
+	memset(&record, 0, sizeof(record));
+	record.id        = item->id;
+	record.remind_at = (gint64) item->remind_at;
+	record.text      = binary_pool_add(writer, item->text);
+	record.parent    = binary_pool_add(writer, item->parent);
+	record.note      = binary_pool_add(writer, item->note);
+	record.done      = (item->done ? 1 : 0);
+	record.repeat    = binary_pool_add(writer, item->repeat);
+	
+	g_string_append_len(writer->contents, (gchar *) &record, sizeof(record));
+	writer->header.count++;
+}
+
+/**
+ * glista_storage_binary_writer_free:
+ * @writer The binary snapshot writer
+ *
+ * Free a binary snapshot writer without writing anything
+ */
+static void
+glista_storage_binary_writer_free(GlistaBinaryWriter *writer)
+{
+	g_hash_table_destroy(writer->offsets);
+	g_string_free(writer->pool, TRUE);
+	g_string_free(writer->contents, TRUE);
+	g_free(writer);
+}
+
+/**
+ * glista_storage_binary_writer_finish:
+ * @writer The binary snapshot writer, freed by this function
+ *
+ * Write a binary snapshot to disk. Must be called right after the matching
+ * XML snapshot is written. Errors are not fatal - the XML file will simply 
+ * be loaded next time.
+ */
+static void
+glista_storage_binary_writer_finish(GlistaBinaryWriter *writer)
+{
+	GError *error = NULL;
+	gchar  *xml_file, *binary_file;
+	
+	xml_file = g_build_filename(gl_globs->configdir, GL_XML_FILENAME, NULL);
+	binary_file = g_build_filename(gl_globs->configdir, GL_BINARY_FILENAME, 
+	                               NULL);
+	
+	if (glista_storage_xml_stat(xml_file, &writer->header.xml_size, 
+	                            &writer->header.xml_mtime)) {
+		
+		writer->header.pool_size = (guint32) writer->pool->len;
+		memcpy(writer->contents->str, &writer->header, sizeof(writer->header));
+		g_string_append_len(writer->contents, writer->pool->str, 
+		                    writer->pool->len);
+		
+		if (! g_file_set_contents(binary_file, writer->contents->str, 
+		                          writer->contents->len, &error)) {
+			g_warning("Unable to write binary snapshot: %s", error->message);
+			g_error_free(error);
+			g_unlink(binary_file);
+		}
+	}
+	
+	glista_storage_binary_writer_free(writer);
+	g_free(xml_file);
+	g_free(binary_file);
+}
+
+/**
+ * glista_storage_binary_write:
+ * @all_items  List of all items in the snapshot
+ * @generation The snapshot generation
+ *
+ * Write the binary copy of a snapshot that was just written to the XML file
+ */
+static void
+glista_storage_binary_write(GList *all_items, guint generation)
+{
+	GlistaBinaryWriter *writer;
+	
+	writer = glista_storage_binary_writer_new(generation);
+	
+	for (; all_items != NULL; all_items = all_items->next) {
+		glista_storage_binary_writer_add(writer, 
+		                                 (GlistaItem *) all_items->data);
+	}
+	
+	glista_storage_binary_writer_finish(writer);
+}
+
+/**
+ * glista_storage_binary_open:
+ * @xml_file Path to the XML snapshot
+ *
+ * Map the binary snapshot into memory, and make sure it is valid and matches
+ * the XML snapshot
+ *
+ * Returns: the mapped binary snapshot, or NULL if it is missing, invalid or 
+ *          does not match the XML snapshot
+ */
+static GMappedFile*
+glista_storage_binary_open(const gchar *xml_file)
+{
+	GMappedFile        *mapped;
+	GlistaBinaryHeader *header;
+	GlistaBinaryRecord *records;
+	const gchar        *contents, *pool;
+	gchar              *binary_file;
+	gsize               length;
+	guint64             xml_size;
+	gint64              xml_mtime;
+	gboolean            valid = TRUE;
+	guint               i;
+	
+	if (! glista_storage_xml_stat(xml_file, &xml_size, &xml_mtime)) {
+		return NULL;
+	}
+	
+	binary_file = g_build_filename(gl_globs->configdir, GL_BINARY_FILENAME, 
+	                               NULL);
+	mapped = g_mapped_file_new(binary_file, FALSE, NULL);
+	g_free(binary_file);
+	
+	if (mapped == NULL) {
+		return NULL;
+	}
+	
+	contents = g_mapped_file_get_contents(mapped);
+	length   = g_mapped_file_get_length(mapped);
+	header   = (GlistaBinaryHeader *) contents;
+	
+	// Make sure this is a binary snapshot of the current XML file
+	if (length < sizeof(GlistaBinaryHeader) ||
+	    memcmp(header->magic, GL_BINARY_MAGIC, sizeof(header->magic)) != 0 ||
+	    header->version != GL_BINARY_VERSION ||
+	    header->byte_order != GL_BINARY_BYTEORDER ||
+	    header->xml_size != xml_size || header->xml_mtime != xml_mtime ||
+	    header->count > (length - sizeof(GlistaBinaryHeader)) / 
+	                    sizeof(GlistaBinaryRecord) ||
+	    length != sizeof(GlistaBinaryHeader) + 
+	              (gsize) header->count * sizeof(GlistaBinaryRecord) + 
+	              header->pool_size ||
+	    (header->pool_size > 0 && contents[length - 1] != '\0')) {
+		
+		g_mapped_file_free(mapped);
+		return NULL;
+	}
+	
+	// Check all records before loading any of them, so that we never load 
+	// part of the binary snapshot and then fall back to the XML file
+	records = (GlistaBinaryRecord *) (contents + sizeof(GlistaBinaryHeader));
+	pool    = (const gchar *) (records + header->count);
+	
+	for (i = 0; i < header->count && valid; i++) {
+		if (binary_pool_get(header, pool, records[i].text, &valid) == NULL) {
+			valid = FALSE;
+		}
+		binary_pool_get(header, pool, records[i].parent, &valid);
+		binary_pool_get(header, pool, records[i].note, &valid);
+		binary_pool_get(header, pool, records[i].repeat, &valid);
+	}
+	
+	if (! valid) {
+		g_mapped_file_free(mapped);
+		return NULL;
+	}
+	
+	return mapped;
+}
+
+/**
+ * glista_storage_load_snapshot_item:
+ * @loader The loader state
+ * @item   An item read from the snapshot
+ *
+ * Pass an item read from the snapshot on to the load callback, unless it was
+ * deleted by the journal
+ */
+static void
+glista_storage_load_snapshot_item(GlistaXmlLoader *loader, 
+                                  GlistaItem *item)
+{
+	guint64  hash, *key;
+	guint    count;
+	
+	if (loader->binary != NULL) {
+		glista_storage_binary_writer_add(loader->binary, item);
+	}
+	
+	hash = glista_storage_item_hash(item);
+	count = GPOINTER_TO_UINT(g_hash_table_lookup(loader->deleted, &hash));
+	
+	if (count > 0) {
+		if (count == 1) {
+			g_hash_table_remove(loader->deleted, &hash);
+		} else {
+			key = g_new(guint64, 1);
+			*key = hash;
+			g_hash_table_replace(loader->deleted, key, 
+			                     GUINT_TO_POINTER(count - 1));
+		}
+		
+	} else {
+		loader->func(item, loader->user_data);
+	}
+}
+
+/**
+ * glista_storage_xml_load_begin:
+ * @error A pointer to fill with an error, if any
+ *
+ * Start loading items. The binary snapshot is used if it is valid, otherwise
+ * the XML file is opened. Items are then read in batches by calling 
+ * glista_storage_xml_load_next(). A missing XML file is not an error - the 
+ * list is simply empty.
+ *
+ * Returns: a newly allocated loader
+ */
+static gpointer
+glista_storage_xml_load_begin(GError **error)
+{
+	GlistaXmlLoader    *loader;
+	GlistaBinaryHeader *header;
+	xmlChar            *node_name, *generation;
+	gchar              *storage_file, *backup_file = NULL;
+	gboolean            valid = FALSE;
+	guint               i;
+	
+	snapshot_generation = 0;
+	snapshot_damaged    = FALSE;
+	
+	loader = g_new0(GlistaXmlLoader, 1);
+	loader->deleted = glista_storage_hash_table_new(NULL);
+	
+	// Build storage file path
+	storage_file = glista_storage_xml_file(0);
+	
+	// Try the binary snapshot first. It is only valid for the XML file it was
+	// written with, which was parsed successfully at the time.
+	loader->mapped = glista_storage_binary_open(storage_file);
+	
+	// Fall back to the last known good copy if the XML file is damaged. If 
+	// there is none, whatever can be read from the damaged file is loaded.
+	if (loader->mapped == NULL && 
+	    g_file_test(storage_file, G_FILE_TEST_EXISTS) &&
+	    (! glista_storage_xml_check(storage_file))) {
+		
+		snapshot_damaged = TRUE;
+		
+		for (i = 1; i <= GL_XML_BACKUPS && backup_file == NULL; i++) {
+			backup_file = glista_storage_xml_file(i);
+			if (! glista_storage_xml_check(backup_file)) {
+				g_free(backup_file);
+				backup_file = NULL;
+			}
+		}
+		
+		if (backup_file != NULL) {
+			g_warning("Storage XML file is damaged, loading backup copy %s\n",
+			          backup_file);
+		} else {
+			g_warning("Storage XML file is damaged and no backup copy was "
+			          "found, loading as many items as possible\n");
+		}
+	}
+	
+	if (loader->mapped != NULL) {
+		header = (GlistaBinaryHeader *) g_mapped_file_get_contents(
+			loader->mapped);
+		snapshot_generation = header->generation;
+		
+	} else if ((loader->xml = xmlReaderForFile(
+	                (backup_file != NULL ? backup_file : storage_file), 
+	                GL_XML_ENCODING, 0)) != NULL) {
+		
+		// Read the XML root node
+		if (xmlTextReaderRead(loader->xml) == 1) {
+			node_name = xmlTextReaderName(loader->xml);
+			
+			if (xmlStrEqual(node_name, BAD_CAST GL_XNODE_ROOT)) {
+				valid = TRUE;
+				
+				// Read the snapshot generation, if any
+				generation = xmlTextReaderGetAttribute(loader->xml, 
+				                                       BAD_CAST GL_XATTR_GENR);
+				if (generation != NULL) {
+					snapshot_generation = (guint) g_ascii_strtoull(
+						(gchar *) generation, NULL, 10);
+					xmlFree(generation);
+				}
+				
+				// Write a binary snapshot while loading, unless the items do 
+				// not come from the current XML file
+				if (! snapshot_damaged) {
+					loader->binary = glista_storage_binary_writer_new(
+						snapshot_generation);
+				}
+				
+			} else {
+				g_warning("Invalid XML file: unexpected root element '%s'\n", 
+				           node_name);
+			}
+			
+			xmlFree(node_name);
+			
+		} else {
+			g_warning("Invalid XML file: unable to read root element\n");
+		}
+		
+		// Without a valid snapshot, the journal holds all items
+		if (! valid) {
+			xmlFreeTextReader(loader->xml);
+			loader->xml = NULL;
+		}
+	}
+	
+	g_free(storage_file);
+	g_free(backup_file);
+	
+	// Read changes made since the snapshot was written
+	loader->inserted = glista_storage_journal_read(loader->deleted);
+	
+	return loader;
+}
+
+/**
+ * glista_storage_xml_load_next:
+ * @data:      The loader
+ * @func:      Function to call for each loaded item
+ * @user_data: User data to pass to @func
+ * @max_items: Maximal number of items to read
+ * @error:     A pointer to fill with an error, if any
+ *
+ * Read the next batch of up to @max_items items. Snapshot items are read 
+ * first, followed by items inserted by the journal.
+ *
+ * Returns: FALSE if all items were loaded or on error, TRUE if there are more
+ *          to read
+ */
+static gboolean
+glista_storage_xml_load_next(gpointer data, GlistaStorageLoadFunc func, 
+                             gpointer user_data, guint max_items, 
+                             GError **error)
+{
+	GlistaXmlLoader    *loader = (GlistaXmlLoader *) data;
+	GlistaBinaryHeader *header;
+	GlistaBinaryRecord *record;
+	GlistaItem          binary_item, *item;
+	const gchar        *pool;
+	gboolean            valid = TRUE;
+	guint               i;
+	
+	loader->func      = func;
+	loader->user_data = user_data;
+	
+	for (i = 0; i < max_items; i++) {
+		
+		// Binary snapshot. Items point directly into the mapped file.
+		if (loader->mapped != NULL) {
+			header = (GlistaBinaryHeader *) g_mapped_file_get_contents(
+				loader->mapped);
+			
+			if (loader->position < header->count) {
+				record = (GlistaBinaryRecord *) (header + 1) + 
+				         loader->position;
+				pool   = (const gchar *) ((GlistaBinaryRecord *) (header + 1) + 
+				                          header->count);
+				
+				binary_item.text      = binary_pool_get(header, pool, 
+				                                        record->text, &valid);
+				binary_item.parent    = binary_pool_get(header, pool, 
+				                                        record->parent, &valid);
+				binary_item.note      = binary_pool_get(header, pool, 
+				                                        record->note, &valid);
+				binary_item.id        = record->id;
+				binary_item.done      = (record->done != 0);
+				binary_item.remind_at = (time_t) record->remind_at;
+				binary_item.repeat    = binary_pool_get(header, pool, 
+				                                        record->repeat, &valid);
+				
+				glista_storage_load_snapshot_item(loader, &binary_item);
+				loader->position++;
+				
+			} else {
+				g_mapped_file_free(loader->mapped);
+				loader->mapped = NULL;
+			}
+			
+		// XML snapshot
+		} else if (loader->xml != NULL) {
+			if ((item = read_next_item(loader->xml)) != NULL) {
+				if (item->text != NULL) {
+					glista_storage_load_snapshot_item(loader, item);
+				}
+				load_item_free(item);
+				
+			} else {
+				xmlFreeTextReader(loader->xml);
+				loader->xml = NULL;
+				
+				if (loader->binary != NULL) {
+					glista_storage_binary_writer_finish(loader->binary);
+					loader->binary = NULL;
+				}
+			}
+			
+		// Items inserted by the journal
+		} else if (loader->inserted != NULL) {
+			item = (GlistaItem *) loader->inserted->data;
+			loader->inserted = g_list_delete_link(loader->inserted, 
+			                                      loader->inserted);
+			
+			func(item, user_data);
+			load_item_free(item);
+			
+		} else {
+			return FALSE;
+		}
+	}
+	
+	return TRUE;
+}
+
+/**
+ * glista_storage_xml_load_end:
+ * @data: The loader to free
+ *
+ * Free a loader. If called before all items were read, the remaining items 
+ * are discarded.
+ */
+static void
+glista_storage_xml_load_end(gpointer data)
+{
+	GlistaXmlLoader *loader = (GlistaXmlLoader *) data;
+	
+	if (loader->mapped != NULL) {
+		g_mapped_file_free(loader->mapped);
+	}
+	
+	if (loader->xml != NULL) {
+		xmlFreeTextReader(loader->xml);
+	}
+	
+	if (loader->binary != NULL) {
+		glista_storage_binary_writer_free(loader->binary);
+	}
+	
+	g_list_foreach(loader->inserted, (GFunc) load_item_free, NULL);
+	g_list_free(loader->inserted);
+	g_hash_table_destroy(loader->deleted);
+	g_free(loader);
+}
+
+/**
+ * glista_storage_write_snapshot: 
+ * @all_items: A linked list of all items to save
+ * @error:     A pointer to fill with an error, if any
+ * 
+ * Write all items to the storage XML file, starting a new snapshot generation.
+ * Items are streamed into a temporary file, which replaces the current XML
+ * file only once it is completely written and synced to disk.
+ *
+ * Returns: TRUE on success, FALSE otherwise
+ */
+static gboolean
+glista_storage_write_snapshot(GList *all_items, GError **error)
+{
+	GlistaItem       *item;
+	GList            *node;
+	xmlTextWriterPtr  xml;
+	int               ret, fd;
+	gchar            *storage_file, *temp_file;
+	gchar             done_str[2];
+	gchar            *remind_at_str;
+	gchar             generation_str[16];
+	gchar             id_str[24];
+	
+	// Build storage file paths
+	storage_file = glista_storage_xml_file(0);
+	temp_file = g_strconcat(storage_file, GL_XML_TEMP_SUFFIX, NULL);
+	
+	// Start XML
+	xml = NULL;
+	fd = g_open(temp_file, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if (fd != -1) {
+		xml = xmlNewTextWriter(xmlOutputBufferCreateFd(fd, NULL));
+	}
+	
+	if (xml == NULL) {
+		g_set_error(error, GLISTA_STORAGE_ERROR_QUARK, 
+		            GLISTA_STORAGE_ERROR_SAVE, 
+		            "Unable to write data to storage XML file");
+		if (fd != -1) {
+			close(fd);
+			g_unlink(temp_file);
+		}
+		g_free(storage_file);
+		g_free(temp_file);
+		return FALSE;
+	}
+	
+	xmlTextWriterSetIndent(xml, 1);
+	xmlTextWriterSetIndentString(xml, BAD_CAST "  ");
+	
+	g_snprintf(generation_str, sizeof(generation_str), "%u", 
+	           snapshot_generation + 1);
+	
+	ret = xmlTextWriterStartDocument(xml, NULL, GL_XML_ENCODING, "yes");
+	ret = xmlTextWriterStartElement(xml, BAD_CAST GL_XNODE_ROOT);
+	ret = xmlTextWriterWriteAttribute(xml, BAD_CAST GL_XATTR_GENR, 
+	                                  BAD_CAST generation_str);
+
+	// Iterate over items, writing them to the XML file
+	for (node = all_items; node != NULL; node = node->next) {
+		item = node->data;
+		
+		g_snprintf((gchar *) &done_str, 2, "%d", item->done);
+		
+		g_snprintf(id_str, sizeof(id_str), "%" G_GUINT64_FORMAT, item->id);
+		
+		ret = xmlTextWriterStartElement(xml, BAD_CAST GL_XNODE_ITEM);
+		ret = xmlTextWriterWriteAttribute(xml, BAD_CAST GL_XATTR_ID, 
+		                                  BAD_CAST id_str);
+		ret = xmlTextWriterWriteElement(xml, BAD_CAST GL_XNODE_TEXT, 
+										BAD_CAST item->text);
+		ret = xmlTextWriterWriteElement(xml, BAD_CAST GL_XNODE_DONE, 
+										BAD_CAST &done_str);
+		
+		if (item->parent != NULL) {
+			ret = xmlTextWriterWriteElement(xml, BAD_CAST GL_XNODE_PRNT, 
+											BAD_CAST item->parent);
+		}
+		
+		if (item->note != NULL) {
+			ret = xmlTextWriterWriteElement(xml, BAD_CAST GL_XNODE_NOTE, 
+			                                BAD_CAST item->note);
+		}
+		
+		if (item->remind_at != -1) {
+			remind_at_str = g_strdup_printf("%d", (gint) item->remind_at);
+			
+			ret = xmlTextWriterStartElement(xml, BAD_CAST GL_XNODE_RMDR);
+			if (item->repeat != NULL) {
+				ret = xmlTextWriterWriteAttribute(xml, BAD_CAST GL_XATTR_RPT,
+				                                  BAD_CAST item->repeat);
+			}
+			ret = xmlTextWriterWriteString(xml, BAD_CAST remind_at_str);
+			ret = xmlTextWriterEndElement(xml);
+			
+			g_free(remind_at_str);
+		}
+		
+		ret = xmlTextWriterEndElement(xml);
+	}
+	
+	// End XML
+	ret = xmlTextWriterEndElement(xml);
+	ret = xmlTextWriterEndDocument(xml);
+	
+	if (xmlTextWriterFlush(xml) < 0) ret = -1;
+	xmlFreeTextWriter(xml);
+	
+	// Make sure the new snapshot is on disk before it replaces the old one
+	if (ret >= 0 && fsync(fd) != 0) ret = -1;
+	if (close(fd) != 0) ret = -1;
+	
+	if (ret < 0) {
+		g_set_error(error, GLISTA_STORAGE_ERROR_QUARK, 
+		            GLISTA_STORAGE_ERROR_SAVE, 
+		            "Error writing data to storage XML file");
+		g_unlink(temp_file);
+		g_free(storage_file);
+		g_free(temp_file);
+		return FALSE;
+	}
+	
+	// Keep the current snapshot as the last known good copy, unless it is 
+	// damaged
+	if (! snapshot_damaged) {
+		glista_storage_xml_rotate();
+	}
+	
+	if (g_rename(temp_file, storage_file) != 0) {
+		g_set_error(error, GLISTA_STORAGE_ERROR_QUARK, 
+		            GLISTA_STORAGE_ERROR_SAVE, 
+		            "Unable to replace storage XML file: %s", 
+		            g_strerror(errno));
+		g_unlink(temp_file);
+		g_free(storage_file);
+		g_free(temp_file);
+		return FALSE;
+	}
+	
+	glista_storage_sync_dir();
+	g_free(storage_file);
+	g_free(temp_file);
+	
+	snapshot_damaged = FALSE;
+	
+	glista_storage_binary_write(all_items, snapshot_generation + 1);
+	
+	snapshot_generation++;
+	return TRUE;
+}
+
+/**
+ * glista_storage_compact_item_cb:
+ * @item:      An item read back from storage
+ * @all_items: Pointer to the list of items to add a copy of @item to
+ *
+ * Load callback used when compacting the journal
+ */
+static void
+glista_storage_compact_item_cb(GlistaItem *item, GList **all_items)
+{
+	GlistaItem *copy;
+	
+	copy = glista_item_new(g_strdup(item->text), g_strdup(item->parent));
+	copy->id        = item->id;
+	copy->done      = item->done;
+	copy->note      = g_strdup(item->note);
+	copy->remind_at = item->remind_at;
+	copy->repeat    = g_strdup(item->repeat);
+	
+	*all_items = g_list_prepend(*all_items, copy);
+}
+
+/**
+ * glista_storage_compact: 
+ * @error: A pointer to fill with an error, if any
+ * 
+ * Compact the journal into a new snapshot. The current snapshot and the 
+ * journal are read back from disk and written out as a new snapshot, so that
+ * no copy of the list has to be kept in memory between saves.
+ *
+ * Returns: TRUE on success, FALSE otherwise
+ */
+static gboolean
+glista_storage_compact(GError **error)
+{
+	gpointer  loader;
+	GList    *all_items = NULL;
+	GError   *load_error = NULL;
+	gboolean  saved = FALSE;
+	
+	if ((loader = glista_storage_xml_load_begin(error)) == NULL) {
+		return FALSE;
+	}
+	
+	while (glista_storage_xml_load_next(loader, 
+		(GlistaStorageLoadFunc) glista_storage_compact_item_cb, &all_items, 
+		G_MAXUINT, &load_error));
+	glista_storage_xml_load_end(loader);
+	all_items = g_list_reverse(all_items);
+	
+	// Never replace the snapshot with a list which was not fully read back
+	if (load_error != NULL) {
+		g_propagate_error(error, load_error);
+		
+	} else if (glista_storage_write_snapshot(all_items, error)) {
+		journal_records = 0;
+		saved = TRUE;
+	}
+	
+	g_list_foreach(all_items, (GFunc) load_item_free, NULL);
+	g_list_free(all_items);
+	
+	return saved;
+}
+
+/**
+ * glista_storage_xml_save: 
+ * @delta: The changes to save
+ * @error: A pointer to fill with an error, if any
+ * 
+ * Save changes. Only the changes since the last save are appended to the 
+ * journal, and the journal is compacted into a new XML snapshot once it has 
+ * grown large enough, or right away if the current snapshot is damaged. If the
+ * delta holds all items, a new snapshot of them is written instead.
+ *
+ * Returns: TRUE on success, FALSE otherwise
+ */
+static gboolean
+glista_storage_xml_save(GlistaStorageDelta *delta, GError **error)
+{
+	GString  *records;
+	GList    *node;
+	GError   *compact_error = NULL;
+	gboolean  saved;
+	
+	if (delta->all_items != NULL) {
+		// Write a new snapshot, making the journal stale
+		saved = glista_storage_write_snapshot(delta->all_items, error);
+		if (saved) {
+			journal_records = 0;
+		}
+		
+		return saved;
+	}
+	
+	records = g_string_new(NULL);
+	
+	for (node = delta->deleted; node != NULL; node = node->next) {
+		journal_write_delete(records, *((guint64 *) node->data));
+	}
+	
+	for (node = delta->inserted; node != NULL; node = node->next) {
+		journal_write_insert(records, (GlistaItem *) node->data);
+	}
+	
+	saved = glista_storage_journal_append(records, error);
+	g_string_free(records, TRUE);
+	
+	if (saved) {
+		journal_records += delta->changes;
+		
+		// The changes are safe in the journal even if compacting fails
+		if ((snapshot_damaged || 
+		     journal_records > GL_JOURNAL_COMPACT_RECORDS) && 
+		    (! glista_storage_compact(&compact_error))) {
+			
+			g_warning("Unable to compact the journal: %s", 
+			          (compact_error != NULL ? compact_error->message : 
+			                                   "unknown error"));
+			if (compact_error != NULL) {
+				g_error_free(compact_error);
+			}
+		}
+	}
+	
+	return saved;
+}
+
+/**
+ * The XML backend function table
+ */
+static GlistaStorageBackend xml_backend = {
+	NULL,
+	NULL,
+	glista_storage_xml_load_begin,
+	glista_storage_xml_load_next,
+	glista_storage_xml_load_end,
+	glista_storage_xml_save
+};
+
+/**
+ * glista_storage_xml_get_backend:
+ *
+ * Get the XML storage backend
+ *
+ * Returns: the XML backend function table
+ */
+GlistaStorageBackend*
+glista_storage_xml_get_backend()
+{
+	return &xml_backend;
+}
+
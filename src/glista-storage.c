@@ -16,13 +16,9 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#define _XOPEN_SOURCE /* glibc2 needs this */
-#include <time.h>
 #include <glib.h>
-#include <libxml/xmlreader.h>
-#include <libxml/xmlwriter.h>
+#include <gmodule.h>
 #include <string.h>
-#include <stdlib.h>
 
 #include "glista.h"
 #include "glista-storage.h"
@@ -30,310 +26,475 @@
 /**
  * Glista Storage Module
  * 
- * Responsible for persistant storage of the items in list. For now we store 
- * data on disk - but in the future might offer more than one storage module 
- * (yeah right ;) )
+ * Responsible for persistant storage of the items in list. The actual storage
+ * is done by a storage backend: the built-in XML backend, or a backend loaded
+ * from a storage module.
+ *
+ * Items are identified by a hash of their content. The list passes only the
+ * items which were deleted or inserted since the last save (an updated item is
+ * a delete plus an insert), and only these are passed on to the backend. If
+ * nothing has changed, nothing is written.
+ */
+
+/**
+ * Loader state, wrapping the backend's loader
+ */
+struct _GlistaStorageLoader {
+	gpointer               data;      // The backend's loader
+	GlistaStorageLoadFunc  func;      // Load callback of the current batch
+	gpointer               user_data; // User data to pass to @func
+};
+
+/**
+ * FNV-1a constants used for hashing item contents
+ */
+#define GL_HASH_FNV_OFFSET G_GUINT64_CONSTANT(14695981039346656037)
+#define GL_HASH_FNV_PRIME  G_GUINT64_CONSTANT(1099511628211)
+
+/**
+ * The storage backend in use, and the module it was loaded from if any
+ */
+static GlistaStorageBackend *backend        = NULL;
+static GModule              *backend_module = NULL;
+
+/**
+ * Set if loading failed. Saving is disabled, so that whatever is stored is 
+ * not overwritten with an empty list.
+ */
+static gboolean load_failed = FALSE;
+
+/**
+ * hash_key_hash:
+ * @key Pointer to a 64 bit content hash
+ *
+ * GHashFunc for tables keyed by 64 bit content hashes
+ *
+ * Returns: a 32 bit hash of the key
+ */
+static guint
+hash_key_hash(gconstpointer key)
+{
+	guint64 hash = *((const guint64 *) key);
+	
+	return (guint) (hash ^ (hash >> 32));
+}
+
+/**
+ * hash_key_equal:
+ * @a First key to compare
+ * @b Second key to compare
+ *
+ * GEqualFunc for tables keyed by 64 bit content hashes
+ *
+ * Returns: TRUE if both keys are equal
+ */
+static gboolean
+hash_key_equal(gconstpointer a, gconstpointer b)
+{
+	return (*((const guint64 *) a) == *((const guint64 *) b));
+}
+
+/**
+ * glista_storage_hash_table_new:
+ * @value_destroy Function to free values, or NULL
+ *
+ * Create a new hash table keyed by 64 bit content hashes
+ *
+ * Returns: a newly created GHashTable
  */
+GHashTable*
+glista_storage_hash_table_new(GDestroyNotify value_destroy)
+{
+	return g_hash_table_new_full(hash_key_hash, hash_key_equal, 
+	                             g_free, value_destroy);
+}
 
 /**
- * read_next_text_node:
- * @xml XML reader
+ * glista_storage_hash_table_queue:
+ * @table Hash table of item queues, keyed by content hash
+ * @hash  The item's content hash
+ * @item  The item to add
+ *
+ * Add an item to the queue of items sharing the same content hash
+ */
+void
+glista_storage_hash_table_queue(GHashTable *table, guint64 hash, 
+                                GlistaItem *item)
+{
+	GQueue  *items;
+	guint64 *key;
+	
+	if ((items = g_hash_table_lookup(table, &hash)) == NULL) {
+		key = g_new(guint64, 1);
+		*key = hash;
+		items = g_queue_new();
+		g_hash_table_insert(table, key, items);
+	}
+	
+	g_queue_push_tail(items, item);
+}
+
+/**
+ * hash_str:
+ * @hash Current hash value
+ * @str  String to add to the hash, may be NULL
+ *
+ * Add a string field to a FNV-1a hash. A terminator is added after each field
+ * so that different splits of the same characters hash differently.
+ *
+ * Returns: the new hash value
+ */
+static guint64
+hash_str(guint64 hash, const gchar *str)
+{
+	if (str != NULL) {
+		for (; *str != '\0'; str++) {
+			hash ^= (guchar) *str;
+			hash *= GL_HASH_FNV_PRIME;
+		}
+		
+		hash ^= 0xff;
+	} else {
+		hash ^= 0xfe;
+	}
+	
+	return hash * GL_HASH_FNV_PRIME;
+}
+
+/**
+ * glista_storage_item_hash:
+ * @item The item to hash
+ *
+ * Calculate a hash of all the persistent properties of an item. Items with 
+ * the same hash are considered identical by the journal.
+ *
+ * Returns: 64 bit content hash
+ */
+guint64
+glista_storage_item_hash(GlistaItem *item)
+{
+	guint64 hash = GL_HASH_FNV_OFFSET;
+	gchar   flags[64];
+	
+	g_snprintf(flags, sizeof(flags), "%d:%ld:%" G_GUINT64_FORMAT, 
+	           (item->done ? 1 : 0), (glong) item->remind_at, item->id);
+	
+	hash = hash_str(hash, flags);
+	hash = hash_str(hash, item->text);
+	hash = hash_str(hash, item->parent);
+	hash = hash_str(hash, item->note);
+	
+	// Items without a recurrence rule hash as they did before rules existed
+	if (item->repeat != NULL) {
+		hash = hash_str(hash, item->repeat);
+	}
+	
+	return hash;
+}
+
+/**
+ * glista_storage_error_quark:
  * 
- * Read the text value of the next node, assuming that it is a text node. If no
- * text node value is encountered before the tag ends, will return NULL
+ * Get the error domain GQuark for glista storage functionality. You should 
+ * use the GLISTA_STORAGE_ERROR_QUARK constant and not this function directly
  * 
- * Returns: text read from node value or NULL if none
+ * Returns: the error quark for this module
  */
-static gchar*
-read_next_text_node(xmlTextReaderPtr xml)
+GQuark
+glista_storage_error_quark()
 {
-	gchar    *text = NULL;
-	gboolean  text_done = FALSE;
-	
-	while ((! text_done) && xmlTextReaderRead(xml) == 1) {
-		switch(xmlTextReaderNodeType(xml)) {
-			case 3: // Text node, read value
-				text = (gchar *) xmlTextReaderValue(xml);
-				g_strstrip(text);
-				text_done = TRUE;
-				break;
-				
-			case 15: // End node - no text
-				text_done = TRUE;
-				break;
-		}
+	static GQuark equark = 0;
+	
+	if (equark == 0) { 
+		equark = g_quark_from_static_string(GLISTA_STORAGE_ERROR_QUARK_S);
 	}
 	
-	return text;
+	return equark;
 }
 
 /**
- * read_next_item: 
- * @xml XML reader
+ * glista_storage_module_path:
+ * @mod_name Name of the module
  * 
- * Read the next item from the XML file and populate it's properties
+ * Build the path to the storage module in a system-independent manner
  * 
- * Returns: a newly created GlistaItem or NULL if nothing more to read
+ * Return: a newly allocated string with the path. Must be freed later.
  */
-static GlistaItem*
-read_next_item(xmlTextReaderPtr xml) 
+static gchar*
+glista_storage_module_path(const gchar *mod_name)
 {
-	gchar      *text, *done, *parent, *note, *remind_at_str;
-	xmlChar    *node_name;
-	gboolean    item_done;
-	GlistaItem *item;
-	
-	item          = NULL;
-	text          = NULL;
-	done          = NULL;
-	parent        = NULL;
-	note          = NULL;
-	remind_at_str = NULL;
-	item_done     = FALSE;
-	
-	while ((! item_done) && xmlTextReaderRead(xml) == 1) {
-		node_name = xmlTextReaderName(xml);
-		
-		if (xmlStrEqual(node_name, BAD_CAST GL_XNODE_ITEM) && 
-		    xmlTextReaderNodeType(xml) == 1) {
-		    
-		    // Create item
-		    item = glista_item_new(NULL, NULL);
-		    
-		    // Read item data
-		    while ((! item_done) && xmlTextReaderRead(xml) == 1) {
-		    	xmlFree(node_name);		    		
-		    	node_name = xmlTextReaderName(xml);
-				
-				// Node text
-				if (xmlStrEqual(node_name, BAD_CAST GL_XNODE_TEXT)) {
-					if (text == NULL) {
-						text = read_next_text_node(xml);
-					}
-					
-				} else 
-				
-				// Node 'done' flag
-				if (xmlStrEqual(node_name, BAD_CAST GL_XNODE_DONE)) {
-					if (done == NULL) {
-						done = read_next_text_node(xml);
-					}
-					
-				} else 
-				
-				// Node parent
-				if (xmlStrEqual(node_name, BAD_CAST GL_XNODE_PRNT)) {
-					if (parent == NULL) {
-						parent = read_next_text_node(xml);
-					}
-					
-				} else 
-				
-				// Node item note
-				if (xmlStrEqual(node_name, BAD_CAST GL_XNODE_NOTE)) {
-					if (note == NULL) {
-						note = read_next_text_node(xml);
-					}
-					
-				} else 
-				
-				// Node reminder
-				if (xmlStrEqual(node_name, BAD_CAST GL_XNODE_RMDR)) {
-					if (remind_at_str == NULL) {
-						remind_at_str = read_next_text_node(xml);
-					}
-					
-				} else 
-				
-				if (xmlStrEqual(node_name, BAD_CAST GL_XNODE_ITEM) && 
-				    xmlTextReaderNodeType(xml) == 15) {
-				    	
-				    item_done = TRUE;
-				}
-			}
-			
-			// Check that we have text and set it
-			if (text != NULL) {
-				if (strlen(text) > 0) {
-					item->text = text;
-				} else {
-					 g_free(text);
-				}
-			}
-			
-			// Set "done" flag
-			if (done != NULL) {
-				if (*done == '1') {
-					item->done = TRUE;	
-				}
-				g_free(done);
-			}
-				
-			
-			// Set the parent if any
-			if (parent != NULL) {
-				if (strlen(parent) > 0) {
-					item->parent = parent;
-				} else {
-					 g_free(parent);
-				}
-			}
-			
-			// Set the note if any
-			if (note != NULL) {
-				if (strlen(note) > 0) {
-					item->note = note; 
-				} else {
-					 g_free(note);
-				}
-			}
-			
-			// Set the reminder time, if set
-			if (remind_at_str != NULL) {
-				if (strlen(remind_at_str) > 0) {
-					item->remind_at = (time_t) atoi(remind_at_str);
-				}
-				
-				g_free(remind_at_str);
-			}
-		}
+	return g_strdup_printf("%s%sglistastorage-%s.%s", GLISTA_LIB_DIR, 
+	                       G_DIR_SEPARATOR_S, mod_name, G_MODULE_SUFFIX);
+}
+
+/**
+ * glista_storage_module_open:
+ * @mod_name Name of the module
+ *
+ * Open a storage module and get its backend function table
+ *
+ * Returns: the backend, or NULL if the module can't be loaded
+ */
+static GlistaStorageBackend*
+glista_storage_module_open(const gchar *mod_name)
+{
+	GlistaStorageBackendGetFunc  get_func;
+	gchar                       *mod_path;
+	
+	mod_path = glista_storage_module_path(mod_name);
+	backend_module = g_module_open(mod_path, G_MODULE_BIND_LAZY);
+	g_free(mod_path);
+	
+	if (backend_module == NULL) {
+		g_critical("Unable to load storage module %s, %s", mod_name, 
+			g_module_error());
+		return NULL;
+	}
+	
+	if (! g_module_symbol(backend_module, "glista_storagebackend_get", 
+		(gpointer *) &get_func) || get_func == NULL) {
 		
-		xmlFree(node_name);
+		g_critical("Can't find storage backend symbol in %s: %s", 
+			mod_name, g_module_error());
+		g_module_close(backend_module);
+		backend_module = NULL;
+		return NULL;
 	}
-
-	return item;
+	
+	return get_func();
 }
 
 /**
- * glista_storage_get_all_items:
- * @list: Pointer to a GList* to populate with GlistaItem objects
+ * glista_storage_init:
+ * @backend_name Name of the storage backend to use
  *
- * Load all items from storage into a linked-list, which will be in turn used
- * to load the data into the GtkListStore of the UI.
+ * Initialize the storage backend. If the backend can't be loaded or 
+ * initialized, the built-in XML backend is used instead.
+ *
+ * Returns: TRUE if the requested backend is used, FALSE otherwise
  */
-void
-glista_storage_load_all_items(GList **list)
+gboolean
+glista_storage_init(const gchar *backend_name)
 {
-	xmlTextReaderPtr  xml;
-	gchar            *storage_file;
-	xmlChar          *node_name;
-	GlistaItem       *item;
+	GError   *error = NULL;
+	gboolean  success = TRUE;
 	
-	// Build storage file path
-	storage_file = g_build_filename(gl_globs->configdir, GL_XML_FILENAME, NULL);
+	glista_storage_shutdown();
 	
-	// Open XML file
-	if ((xml = xmlReaderForFile(storage_file, GL_XML_ENCODING, 0)) != NULL) {
+	if (backend_name != NULL && strcmp(backend_name, GL_STORAGE_BACKEND) != 0) {
+		backend = glista_storage_module_open(backend_name);
 		
-		// Read the XML root node
-		if (xmlTextReaderRead(xml) == 1) {
-			node_name = xmlTextReaderName(xml);
+		if (backend != NULL && backend->init != NULL && 
+		    (! backend->init(&error))) {
 			
-			if (xmlStrEqual(node_name, BAD_CAST GL_XNODE_ROOT)) {
-				
-				// Read all items 
-				while ((item = read_next_item(xml)) != NULL) {
-					if (item->text != NULL) {
-						*list = g_list_append(*list, item);
-					} else {
-						glista_item_free(item);
-					}
-				}
-				
-			} else {
-				g_warning("Invalid XML file: unexpected root element '%s'\n", 
-				           node_name);
+			g_critical("Error initializing storage backend %s: %s", 
+			           backend_name, 
+			           (error != NULL ? error->message : "unknown error"));
+			if (error != NULL) {
+				g_error_free(error);
 			}
 			
-			xmlFree(node_name);
-			
-		} else {
-			g_warning("Invalid XML file: unable to read root element\n");
+			glista_storage_shutdown();
 		}
 		
-		xmlFreeTextReader(xml);
+		if (backend == NULL) {
+			g_warning("Falling back to the default storage backend");
+			success = FALSE;
+		}
+	}
+	
+	if (backend == NULL) {
+		backend = glista_storage_xml_get_backend();
 	}
 	
-	g_free(storage_file);
+	return success;
 }
 
 /**
- * glista_storage_save_all_items: 
- * @all_items: A linked list of all items to save
- * 
- * Save all items to the storage XML file
+ * glista_storage_shutdown:
+ *
+ * Shut down the storage backend
  */
-void 
-glista_storage_save_all_items(GList *all_items)
+void
+glista_storage_shutdown()
 {
-	GlistaItem       *item;
-	xmlTextWriterPtr  xml;
-	int               ret;
-	gchar            *storage_file;
-	gchar             done_str[2];
-	gchar            *remind_at_str;
-	
-	remind_at_str = g_malloc0(sizeof(gchar) * 20);
-	
-	// Build storage file path
-	storage_file = g_build_filename(gl_globs->configdir, 
-									GL_XML_FILENAME, NULL);
-	
-	// Start XML
-	xml = xmlNewTextWriterFilename(storage_file, 0);
-	g_free(storage_file);
-	
-	if (xml == NULL) {
-		fprintf(stderr, "Unable to write data to storage XML file\n");
-		return;
+	GError *error = NULL;
+	
+	if (backend != NULL && backend->shutdown != NULL) {
+		if (! backend->shutdown(&error)) {
+			if (error != NULL) {
+				g_critical("Error shutting down storage backend: %s", 
+				           error->message);
+				g_error_free(error);
+			}
+		}
 	}
 	
-	xmlTextWriterSetIndent(xml, 1);
-	xmlTextWriterSetIndentString(xml, BAD_CAST "  ");
+	backend = NULL;
 	
-	ret = xmlTextWriterStartDocument(xml, NULL, GL_XML_ENCODING, "yes");
-	ret = xmlTextWriterStartElement(xml, BAD_CAST GL_XNODE_ROOT);
-
-	// Iterate over items, writing them to the XML file
-	while (all_items != NULL) {
-		item = all_items->data;
-		
-		g_snprintf((gchar *) &done_str, 2, "%d", item->done);
-		
-		ret = xmlTextWriterStartElement(xml, BAD_CAST GL_XNODE_ITEM);
-		ret = xmlTextWriterWriteElement(xml, BAD_CAST GL_XNODE_TEXT, 
-										BAD_CAST item->text);
-		ret = xmlTextWriterWriteElement(xml, BAD_CAST GL_XNODE_DONE, 
-										BAD_CAST &done_str);
-		
-		if (item->parent != NULL) {
-			ret = xmlTextWriterWriteElement(xml, BAD_CAST GL_XNODE_PRNT, 
-											BAD_CAST item->parent);
+	if (backend_module != NULL) {
+		if (! g_module_close(backend_module)) {
+			g_warning("Unable to properly close storage module: %s",
+				g_module_error());
 		}
 		
-		if (item->note != NULL) {
-			ret = xmlTextWriterWriteElement(xml, BAD_CAST GL_XNODE_NOTE, 
-			                                BAD_CAST item->note);
-		}
-		
-		if (item->remind_at != -1) {
-			remind_at_str = g_strdup_printf("%d", (gint) item->remind_at);
-			
-			ret = xmlTextWriterWriteElement(xml, BAD_CAST GL_XNODE_RMDR,
-			                                BAD_CAST remind_at_str);
+		backend_module = NULL;
+	}
+}
+
+/**
+ * glista_storage_load_item_cb:
+ * @item   An item loaded by the backend
+ * @loader The loader
+ *
+ * Called by the backend for each loaded item. Passes it on to the load 
+ * callback.
+ */
+static void
+glista_storage_load_item_cb(GlistaItem *item, GlistaStorageLoader *loader)
+{
+	loader->func(item, loader->user_data);
+}
+
+/**
+ * glista_storage_load_begin:
+ *
+ * Start loading items from storage. Items are then read in batches by 
+ * calling glista_storage_load_next().
+ *
+ * Returns: a newly allocated loader, to be freed with glista_storage_load_end()
+ */
+GlistaStorageLoader*
+glista_storage_load_begin()
+{
+	GlistaStorageLoader *loader;
+	GError              *error = NULL;
+	
+	if (backend == NULL) {
+		glista_storage_init(NULL);
+	}
+	
+	loader = g_new0(GlistaStorageLoader, 1);
+	loader->data = backend->load_begin(&error);
+	
+	if (loader->data == NULL) {
+		g_critical("Unable to load items from storage, saving is disabled: %s",
+		           (error != NULL ? error->message : "unknown error"));
+		if (error != NULL) {
+			g_error_free(error);
 		}
 		
-		ret = xmlTextWriterEndElement(xml);
+		load_failed = TRUE;
+	}
+	
+	return loader;
+}
+
+/**
+ * glista_storage_load_next:
+ * @loader:    The loader
+ * @func:      Function to call for each loaded item
+ * @user_data: User data to pass to @func
+ * @max_items: Maximal number of items to read
+ *
+ * Read the next batch of up to @max_items items, calling @func for each item
+ * as soon as it is read. The item and its strings are only valid during the
+ * call to @func. If the backend fails to read items, loading stops and saving
+ * is disabled, as if loading failed to begin.
+ *
+ * Returns: FALSE if all items were loaded, TRUE if there are more to read
+ */
+gboolean
+glista_storage_load_next(GlistaStorageLoader *loader, 
+                         GlistaStorageLoadFunc func, gpointer user_data, 
+                         guint max_items)
+{
+	GError   *error = NULL;
+	gboolean  more;
+	
+	if (loader->data == NULL) {
+		return FALSE;
+	}
+	
+	loader->func      = func;
+	loader->user_data = user_data;
+	
+	more = backend->load_next(loader->data, 
+	                          (GlistaStorageLoadFunc) glista_storage_load_item_cb,
+	                          loader, max_items, &error);
+	
+	if (error != NULL) {
+		g_critical("Unable to load items from storage, saving is disabled: %s",
+		           error->message);
+		g_error_free(error);
 		
-		all_items = all_items->next;
+		load_failed = TRUE;
+		more = FALSE;
 	}
 	
-	g_free(remind_at_str);
+	return more;
+}
+
+/**
+ * glista_storage_load_end:
+ * @loader: The loader to free
+ *
+ * Free a loader. If called before all items were read, the remaining items 
+ * are discarded.
+ */
+void
+glista_storage_load_end(GlistaStorageLoader *loader)
+{
+	if (loader->data != NULL) {
+		backend->load_end(loader->data);
+	}
 	
-	// End XML
-	ret = xmlTextWriterEndElement(xml);
-	ret = xmlTextWriterEndDocument(xml);
+	g_free(loader);
+}
+
+/**
+ * glista_storage_save_changes: 
+ * @deleted:   Content hashes (guint64 *) of the items as they were last saved
+ * @inserted:  Items inserted or changed since the last save
+ * @all_items: All items in the list, or NULL
+ * 
+ * Save the changes made to the list since the last save. An item which was 
+ * changed is passed both as deleted and as inserted. If @all_items is passed,
+ * the backend rewrites all items instead, for when what is stored may have 
+ * gone out of sync with the list. If nothing has changed, nothing is written.
+ *
+ * Returns: FALSE if saving failed, TRUE otherwise
+ */
+gboolean
+glista_storage_save_changes(GList *deleted, GList *inserted, 
+                            GList *all_items)
+{
+	GlistaStorageDelta  delta;
+	GError             *error = NULL;
+	gboolean            saved = TRUE;
+	
+	if (load_failed) {
+		return TRUE;
+	}
+	
+	if (backend == NULL) {
+		glista_storage_init(NULL);
+	}
+	
+	delta.all_items = all_items;
+	delta.deleted   = deleted;
+	delta.inserted  = inserted;
+	delta.changes   = g_list_length(deleted) + g_list_length(inserted);
+	
+	if (delta.changes > 0 || all_items != NULL) {
+		if (! (saved = backend->save(&delta, &error))) {
+			g_warning("Unable to save items: %s", 
+			          (error != NULL ? error->message : "unknown error"));
+			if (error != NULL) {
+				g_error_free(error);
+			}
+		}
+	}
 	
-	xmlTextWriterFlush(xml);
-	xmlFreeTextWriter(xml);
+	return saved;
 }
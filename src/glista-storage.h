@@ -27,6 +27,30 @@
 // Constants
 #define GL_XML_ENCODING "UTF-8"
 #define GL_XML_FILENAME "itemstore.xml"
+#define GL_JOURNAL_FILENAME "itemstore.journal"
+#define GL_BINARY_FILENAME "itemstore.bin"
+#define GL_XML_TEMP_SUFFIX ".tmp"
+#define GL_JOURNAL_LOST_SUFFIX ".lost"
+
+// Number of last-known-good copies of the XML snapshot to keep
+#ifndef GL_XML_BACKUPS
+#define GL_XML_BACKUPS 3
+#endif
+
+// Number of journal records after which the full XML snapshot is rewritten
+#ifndef GL_JOURNAL_COMPACT_RECORDS
+#define GL_JOURNAL_COMPACT_RECORDS 1000
+#endif
+
+// Journal record types
+#define GL_JOURNAL_INSERT '+'
+#define GL_JOURNAL_DELETE '-'
+
+// Binary snapshot format
+#define GL_BINARY_MAGIC     "GLSB"
+#define GL_BINARY_VERSION   3
+#define GL_BINARY_BYTEORDER 0x01020304
+#define GL_BINARY_NULL      G_MAXUINT32
 
 // Node names
 #define GL_XNODE_ROOT "glista"
@@ -37,9 +61,74 @@
 #define GL_XNODE_NOTE "note"
 #define GL_XNODE_RMDR "reminder"
 
+// Attribute names
+#define GL_XATTR_GENR "generation"
+#define GL_XATTR_ID   "id"
+#define GL_XATTR_RPT  "repeat"
+
+#define GL_STORAGE_BACKEND "xml"
+
+// Callback called for each item loaded from storage
+typedef void (*GlistaStorageLoadFunc)(GlistaItem *item, gpointer user_data);
+
+// Loader state, private to the storage module
+typedef struct _GlistaStorageLoader GlistaStorageLoader;
+
+// Changes to save, passed to storage backends
+typedef struct _glista_storage_delta {
+	GList *all_items; // All items, if all have to be rewritten, or NULL
+	GList *deleted;   // Content hashes (guint64 *) of deleted items
+	GList *inserted;  // Items inserted since the last save
+	guint  changes;   // Number of deleted and inserted items
+} GlistaStorageDelta;
+
+// Storage backend function table. Backends are either built in, or loaded 
+// from a module exporting glista_storagebackend_get(). The init and shutdown 
+// functions are optional.
+typedef struct _glista_storage_backend {
+	gboolean (* init)       (GError **error);
+	gboolean (* shutdown)   (GError **error);
+	gpointer (* load_begin) (GError **error);
+	gboolean (* load_next)  (gpointer loader, GlistaStorageLoadFunc func, 
+	                         gpointer user_data, guint max_items, 
+	                         GError **error);
+	void     (* load_end)   (gpointer loader);
+	gboolean (* save)       (GlistaStorageDelta *delta, GError **error);
+} GlistaStorageBackend;
+
+typedef GlistaStorageBackend* (* GlistaStorageBackendGetFunc) ();
+
+// GError domain GQuark and error codes
+#define GLISTA_STORAGE_ERROR_QUARK_S "glista-storage"
+#define GLISTA_STORAGE_ERROR_QUARK glista_storage_error_quark()
+
+enum {
+	GLISTA_STORAGE_ERROR_INIT,
+	GLISTA_STORAGE_ERROR_LOAD,
+	GLISTA_STORAGE_ERROR_SAVE,
+	GLISTA_STORAGE_ERROR_OTHER
+};
+
 // Function prototypes
-void glista_storage_load_all_items(GList **list);
-void glista_storage_save_all_items(GList *all_items);
+gboolean glista_storage_init(const gchar *backend_name);
+void glista_storage_shutdown();
+GlistaStorageLoader *glista_storage_load_begin();
+gboolean glista_storage_load_next(GlistaStorageLoader *loader, 
+                                  GlistaStorageLoadFunc func, 
+                                  gpointer user_data, guint max_items);
+void glista_storage_load_end(GlistaStorageLoader *loader);
+gboolean glista_storage_save_changes(GList *deleted, GList *inserted, 
+                                     GList *all_items);
+GQuark glista_storage_error_quark();
+
+// Functions for use by storage backends
+guint64 glista_storage_item_hash(GlistaItem *item);
+GHashTable *glista_storage_hash_table_new(GDestroyNotify value_destroy);
+void glista_storage_hash_table_queue(GHashTable *table, guint64 hash, 
+                                     GlistaItem *item);
+
+// Built-in backends
+GlistaStorageBackend *glista_storage_xml_get_backend();
 
 #define __GLISTA_STORAGE_H
 #endif
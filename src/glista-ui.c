@@ -37,9 +37,19 @@
 enum {
 	GL_PL_COL_NAME,
 	GL_PL_COL_PATH,
+	GL_PL_COL_PLUGIN,
 	GL_PL_NUM_COLS
 };
 
+/**
+ * Columns enum for reminder recurrence dropdown GtkListStore
+ */
+enum {
+	GL_RPT_COL_NAME,
+	GL_RPT_COL_RULE,
+	GL_RPT_NUM_COLS
+};
+
 /**
  * Glista - GTK UI Functions and event handler callbacks
  *
@@ -226,15 +236,18 @@ on_item_done_toggled(GtkCellRendererToggle *renderer, gchar *pathstr,
  * @iter:      Tree iter
  * @user_data: User data
  *
- * Called when the data in a row has changed. Will schedule a data save timeout
- * by calling glista_list_save_timeout()
+ * Called when the data in a row has changed. If any persistent data has 
+ * changed, will mark the row as changed and schedule a data save timeout by 
+ * calling glista_list_save_timeout()
  */
 void 
 on_itemstore_row_changed(GtkTreeModel *model, GtkTreePath *path, 
                          GtkTreeIter *iter, gpointer user_data)
 {
-	glista_item_redraw_parent(iter);
-	glista_list_save_timeout();
+	// Redraws and other changes to unsaved columns do not require saving
+	if (glista_item_update_hash(iter)) {
+		glista_list_save_timeout();
+	}
 }
 
 /**
@@ -244,13 +257,15 @@ on_itemstore_row_changed(GtkTreeModel *model, GtkTreePath *path,
  * @iter:      Tree iter
  * @user_data: User data
  *
- * Called when a new row is inserted to the model. Will schedule a data save 
- * timeout by calling glista_list_save_timeout()
+ * Called when a new row is inserted to the model. Will add the row to the item
+ * counts of the parent category, if any, and schedule a data save timeout by 
+ * calling glista_list_save_timeout()
  */
 void 
 on_itemstore_row_inserted(GtkTreeModel *model, GtkTreePath *path, 
                           GtkTreeIter *iter, gpointer user_data)
 {
+	glista_item_count_in_parent(iter, 1);
 	glista_list_save_timeout();
 }
 
@@ -261,7 +276,8 @@ on_itemstore_row_inserted(GtkTreeModel *model, GtkTreePath *path,
  * @user_data: User data
  *
  * Called when a row in the model is deleted. Will schedule a data save timeout
- * by calling glista_list_save_timeout()
+ * by calling glista_list_save_timeout(). The row is gone by now, so rows are
+ * removed from the item counts of their category before they are deleted.
  */
 void 
 on_itemstore_row_deleted(GtkTreeModel *model, GtkTreePath *path, 
@@ -460,6 +476,61 @@ glista_ui_shutdown()
 	glista_ui_mainwindow_store_geo(GTK_WINDOW(window));
 }
 
+/**
+ * glista_ui_remwindow_load_repeat:
+ * @combo The recurrence rule GtkComboBox
+ * 
+ * Load the recurrence rule choices into the "set reminder" window combo box,
+ * if not loaded yet, and select "Does not repeat". A monthly rule repeats on
+ * the day of the reminder date, which is only known when the reminder is set.
+ */
+static void
+glista_ui_remwindow_load_repeat(GtkComboBox *combo)
+{
+	GtkListStore    *repeatstore;
+	GtkCellRenderer *cell;
+	GtkTreeIter      iter;
+	
+	if (gtk_combo_box_get_model(combo) == NULL) {
+		repeatstore = gtk_list_store_new(GL_RPT_NUM_COLS, 
+		                                 G_TYPE_STRING,  // Display Name
+		                                 G_TYPE_STRING); // Rule
+		
+		gtk_list_store_append(repeatstore, &iter);
+		gtk_list_store_set(repeatstore, &iter, 
+		                   GL_RPT_COL_NAME, _("Does not repeat"), 
+		                   GL_RPT_COL_RULE, NULL, -1);
+		gtk_list_store_append(repeatstore, &iter);
+		gtk_list_store_set(repeatstore, &iter, 
+		                   GL_RPT_COL_NAME, _("Every day"), 
+		                   GL_RPT_COL_RULE, GLISTA_REPEAT_RULE_DAILY, -1);
+		gtk_list_store_append(repeatstore, &iter);
+		gtk_list_store_set(repeatstore, &iter, 
+		                   GL_RPT_COL_NAME, _("Every weekday"), 
+		                   GL_RPT_COL_RULE, GLISTA_REPEAT_RULE_WEEKDAYS, -1);
+		gtk_list_store_append(repeatstore, &iter);
+		gtk_list_store_set(repeatstore, &iter, 
+		                   GL_RPT_COL_NAME, _("Every hour"), 
+		                   GL_RPT_COL_RULE, GLISTA_REPEAT_RULE_HOURS ":1", -1);
+		gtk_list_store_append(repeatstore, &iter);
+		gtk_list_store_set(repeatstore, &iter, 
+		                   GL_RPT_COL_NAME, _("Every month"), 
+		                   GL_RPT_COL_RULE, GLISTA_REPEAT_RULE_MONTHLY, -1);
+		
+		// Set up the combobox cell renderrer
+		cell = gtk_cell_renderer_text_new();
+		gtk_cell_layout_pack_start(GTK_CELL_LAYOUT(combo), cell, TRUE);
+		gtk_cell_layout_set_attributes(GTK_CELL_LAYOUT(combo), cell, 
+		                               "text", GL_RPT_COL_NAME, 
+		                               NULL);
+		
+		gtk_combo_box_set_model(combo, GTK_TREE_MODEL(repeatstore));
+		g_object_unref(repeatstore);
+	}
+	
+	gtk_combo_box_set_active(combo, 0);
+}
+
 /**
  * glista_ui_remwindow_show:
  * 
@@ -499,6 +570,10 @@ glista_ui_remwindow_show()
 	gtk_spin_button_set_value(hr_in, (gdouble) now_tm.tm_hour);
 	gtk_spin_button_set_value(min_in, (gdouble) now_tm.tm_min);
 	
+	// Reset the recurrence rule
+	glista_ui_remwindow_load_repeat(
+		GTK_COMBO_BOX(glista_get_widget("reminder_repeat")));
+	
 	// Show the window
 	gtk_widget_show(rem_window);
 }
@@ -577,7 +652,8 @@ glista_ui_prefswindow_load_pluginlist(GtkComboBox *combo, GList *plugins)
 		// Load all plugins into a GtkListStore
 		pluginstore = gtk_list_store_new(GL_PL_NUM_COLS, 
 	                                     G_TYPE_STRING,  // Display Name 
-	                                     G_TYPE_STRING); // Plugin path
+	                                     G_TYPE_STRING,  // Plugin path
+	                                     G_TYPE_STRING); // Plugin name
 
 		// Set up the combobox cell renderrer
 		cell = gtk_cell_renderer_text_new();
@@ -601,27 +677,84 @@ glista_ui_prefswindow_load_pluginlist(GtkComboBox *combo, GList *plugins)
 		gtk_list_store_set(pluginstore, &iter, 
 	    	               GL_PL_COL_NAME, plugin->display_name,
 						   GL_PL_COL_PATH, plugin->module_path,
+						   GL_PL_COL_PLUGIN, plugin->plugin_name,
 						   -1);
 
 		glista_plugin_free(node->data);
 	}
 }
 
+/**
+ * glista_ui_prefswindow_plugin_module:
+ * @combo The reminder plugin combo box
+ * @iter  The row of the plugin
+ * 
+ * Get the name of the reminder module of a plugin in the plugin combo box. 
+ * The module name is the plugin name without the "reminder-" prefix.
+ * 
+ * Returns: A newly allocated string, or NULL if the plugin has no name
+ */
+static gchar*
+glista_ui_prefswindow_plugin_module(GtkComboBox *combo, GtkTreeIter *iter)
+{
+	gchar *plugin_name, *mod_name;
+	
+	gtk_tree_model_get(gtk_combo_box_get_model(combo), iter, 
+	                   GL_PL_COL_PLUGIN, &plugin_name, -1);
+	if (plugin_name == NULL) return NULL;
+	
+	if (g_str_has_prefix(plugin_name, "reminder-")) {
+		mod_name = g_strdup(plugin_name + strlen("reminder-"));
+	} else {
+		mod_name = g_strdup(plugin_name);
+	}
+	
+	g_free(plugin_name);
+	return mod_name;
+}
+
+/**
+ * glista_ui_prefswindow_show:
+ * 
+ * Show the "preferences" window, loading the list of reminder plugins and 
+ * selecting the one in use.
+ */
 static void
 glista_ui_prefswindow_show()
 {
 	GList        *plugins;
 	GtkWidget    *prefs_win;
 	GtkComboBox  *rem_plugins_box;
+	GtkTreeModel *model;
+	GtkTreeIter   iter;
+	gchar        *mod_name;
+	const gchar  *current;
+	gboolean      found = FALSE;
 	
 	prefs_win = GTK_WIDGET(glista_get_widget("glista_prefs_window"));
-	plugins = glista_plugin_query_plugins(GLISTA_PLUGIN_ALL);
+	plugins = glista_plugin_query_plugins(GLISTA_PLUGIN_REMINDER);
 	
 	// Load the plugin list into the reminder plugin combobox
 	rem_plugins_box = GTK_COMBO_BOX(glista_get_widget("reminder_plugin_combo"));
 	glista_ui_prefswindow_load_pluginlist(rem_plugins_box, plugins);
 	g_list_free(plugins);
 	
+	// Select the plugin of the configured reminder module
+	current = (gl_globs->config->reminder_module != NULL ? 
+	           gl_globs->config->reminder_module : GLISTA_RH_MODULE);
+	model = gtk_combo_box_get_model(rem_plugins_box);
+	if (gtk_tree_model_get_iter_first(model, &iter)) {
+		do {
+			mod_name = glista_ui_prefswindow_plugin_module(rem_plugins_box, 
+			                                               &iter);
+			found = (mod_name != NULL && strcmp(mod_name, current) == 0);
+			g_free(mod_name);
+		} while ((! found) && gtk_tree_model_iter_next(model, &iter));
+	}
+	if (found) {
+		gtk_combo_box_set_active_iter(rem_plugins_box, &iter);
+	}
+	
 	gtk_widget_show_all(prefs_win);
 }
 
@@ -1023,10 +1156,12 @@ on_reminder_cal_day_selected(GtkCalendar *cal, gpointer user_data)
 void
 on_reminder_add_btn_clicked(GtkObject *object, gpointer user_data)
 {
-	GtkEntry  *date_in, *hour_in, *min_in;
-	gchar     *time_str;
-	struct tm  time_tm;
-	time_t     now, remind_at;
+	GtkEntry    *date_in, *hour_in, *min_in;
+	GtkComboBox *repeat_in;
+	GtkTreeIter  iter;
+	gchar       *time_str, *repeat = NULL;
+	struct tm    time_tm;
+	time_t       now, remind_at;
 	
 	date_in = GTK_ENTRY(glista_get_widget("reminder_date"));
 	hour_in = GTK_ENTRY(glista_get_widget("reminder_hour"));
@@ -1049,7 +1184,23 @@ on_reminder_add_btn_clicked(GtkObject *object, gpointer user_data)
 	remind_at = mktime(&time_tm);
 	g_free(time_str);
 	
-	glista_reminder_set_on_selected(remind_at);
+	// Get the recurrence rule, if any. Monthly reminders repeat on the day 
+	// they are set for.
+	repeat_in = GTK_COMBO_BOX(glista_get_widget("reminder_repeat"));
+	if (gtk_combo_box_get_active_iter(repeat_in, &iter)) {
+		gtk_tree_model_get(gtk_combo_box_get_model(repeat_in), &iter, 
+		                   GL_RPT_COL_RULE, &repeat, -1);
+		
+		if (repeat != NULL && 
+		    strcmp(repeat, GLISTA_REPEAT_RULE_MONTHLY) == 0) {
+			g_free(repeat);
+			repeat = g_strdup_printf("%s:%d", GLISTA_REPEAT_RULE_MONTHLY, 
+			                         time_tm.tm_mday);
+		}
+	}
+	
+	glista_reminder_set_on_selected(remind_at, repeat);
+	g_free(repeat);
 	
 	glista_ui_remwindow_hide();
 }
@@ -1176,3 +1327,37 @@ on_prefs_window_closed(GtkObject *object, gpointer user_data)
 {
 	glista_ui_prefswindow_hide();
 }
+
+/**
+ * on_reminder_plugin_combo_changed:
+ * @combo     The reminder plugin combo box
+ * @user_data Any data bound at signal connect time
+ * 
+ * Handle the selection of a reminder plugin in the preferences window. The
+ * selected module replaces the current one right away, and is saved in the
+ * configuration file.
+ */
+void
+on_reminder_plugin_combo_changed(GtkComboBox *combo, gpointer user_data)
+{
+	GtkTreeIter  iter;
+	gchar       *mod_name;
+	
+	if (! gtk_combo_box_get_active_iter(combo, &iter)) return;
+	
+	mod_name = glista_ui_prefswindow_plugin_module(combo, &iter);
+	if (mod_name == NULL) return;
+	
+	// Nothing to do if the module did not change, e.g. when the window is 
+	// shown and the current module is selected
+	if (strcmp(mod_name, (gl_globs->config->reminder_module != NULL ? 
+	                      gl_globs->config->reminder_module : 
+	                      GLISTA_RH_MODULE)) == 0) {
+		g_free(mod_name);
+		return;
+	}
+	
+	g_free(gl_globs->config->reminder_module);
+	gl_globs->config->reminder_module = mod_name;
+	glista_reminder_set_module(mod_name);
+}
@@ -31,6 +31,8 @@
 #include <glib.h>
 #include <gtk/gtk.h>
 
+#include "glista-item-store.h"
+
 #define _XOPEN_SOURCE
 
 #ifndef GLISTA_DATA_DIR 
@@ -45,6 +47,26 @@
 #define GLISTA_SAVE_TIMEOUT 3000
 #endif
 
+#ifndef GLISTA_SAVE_TIMEOUT_MAX
+#define GLISTA_SAVE_TIMEOUT_MAX 30000
+#endif
+
+#ifndef GLISTA_SAVE_MAX_LATENCY
+#define GLISTA_SAVE_MAX_LATENCY 60000
+#endif
+
+#ifndef GLISTA_SAVE_COST_FACTOR
+#define GLISTA_SAVE_COST_FACTOR 4
+#endif
+
+#ifndef GLISTA_LOAD_CHUNK
+#define GLISTA_LOAD_CHUNK 200
+#endif
+
+#ifndef GLISTA_SAVE_SHUTDOWN_TIMEOUT
+#define GLISTA_SAVE_SHUTDOWN_TIMEOUT 10000
+#endif
+
 #ifndef GLISTA_CAT_DELIM
 #define GLISTA_CAT_DELIM ":"
 #endif
@@ -55,7 +77,7 @@
 
 // A couple of convenience macros to access the item store
 #define GL_ITEMSTM GTK_TREE_MODEL(gl_globs->itemstore)
-#define GL_ITEMSTS GTK_TREE_STORE(gl_globs->itemstore)
+#define GL_ITEMSTS GLISTA_ITEM_STORE(gl_globs->itemstore)
 
 // Glista configuration data struct
 typedef struct _glista_config_struct {
@@ -65,13 +87,18 @@ typedef struct _glista_config_struct {
 	gint     height;
 	gboolean visible;
 	gboolean note_vpane_pos;
+	gchar   *storage_backend;
+	guint    reminder_batch_window;
+	guint    reminder_catchup;  // See GlistaReminderCatchup
+	gchar   *reminder_module;
 } GlistaConfig;
 
 // Glista globals container struct
 typedef struct  _glista_globals_struct {
 	GlistaConfig  *config;     // Configuration Data
-	GtkTreeStore  *itemstore;  // Item storage
-	GHashTable    *categories; // HT containing pointers to item categories
+	GlistaItemStore *itemstore; // Item storage
+	GHashTable    *categories; // HT mapping category names to category IDs
+	GHashTable    *items;      // HT mapping item IDs to their rows
 	GtkBuilder    *uibuilder;  // UI Builder
 	gchar         *configdir;  // Configuration directory path
 	GtkTreeIter   *open_note;  // Iterator pointing to the current open note
@@ -81,13 +108,21 @@ typedef struct  _glista_globals_struct {
 
 // Glista item data structure
 typedef struct _glista_data_struct {
+	guint64   id;        // Persistent item ID, 0 if not assigned yet
 	gboolean  done;
 	gchar    *text;
 	gchar    *parent;
 	gchar    *note;
 	time_t    remind_at;
+	gchar    *repeat;    // Reminder recurrence rule, NULL if not repeating
 } GlistaItem;
 
+// Batch of list mutations, see glista_batch_new()
+typedef struct {
+	GHashTable *deletes;   // Rows to delete, keyed by their tree node
+	GList      *reminders; // Reminder changes, in reverse order
+} GlistaBatch;
+
 // Globals container
 GlistaGlobals *gl_globs;
 
@@ -96,11 +131,29 @@ GlistaItem  *glista_item_new(const gchar *text, const gchar *parent);
 void         glista_item_create_from_text(gchar *text);
 void         glista_item_toggle_done(GtkTreePath *path);
 void         glista_item_change_text(GtkTreePath *path, gchar *text);
-void         glista_item_redraw_parent(GtkTreeIter *child_iter);
+void         glista_item_count_in_parent(GtkTreeIter *child_iter, gint count);
+gboolean     glista_item_update_hash(GtkTreeIter *iter);
+gboolean     glista_item_get_iter(guint64 id, GtkTreeIter *iter);
+void         glista_item_index(GtkTreeIter *iter);
+void         glista_item_unindex(GtkTreeIter *iter);
 void         glista_item_free(GlistaItem *item);
+void         glista_category_delete(GtkTreeIter *category);
+void         glista_category_update_counts(GtkTreeIter *category);
+void         glista_category_adjust_counts(GtkTreeIter *category, gint done, 
+                                           gint total);
 GtkTreeIter *glista_item_get_single_selected(GtkTreeSelection *selection);
 void         glista_list_save_timeout();
-GList*       glista_list_get_selected();
+guint        glista_list_save_get_window();
+guint        glista_list_save_get_last_duration();
+void         glista_list_bulk_begin();
+void         glista_list_bulk_end(gboolean changed);
+GList*       glista_list_get_selected_iters();
+GlistaBatch *glista_batch_new();
+void         glista_batch_delete(GlistaBatch *batch, GtkTreeIter *iter);
+void         glista_batch_set_reminder(GlistaBatch *batch, GtkTreeIter *iter,
+                                       time_t remind_at, const gchar *repeat);
+void         glista_batch_commit(GlistaBatch *batch);
+void         glista_batch_free(GlistaBatch *batch);
 void         glista_list_delete_done();
 void         glista_list_delete_selected();
 void         glista_note_toggle(GtkTreeIter *iter);
@@ -115,7 +168,13 @@ typedef enum {
 	GL_COLUMN_TEXT,
 	GL_COLUMN_CATEGORY,
 	GL_COLUMN_NOTE,
-	GL_COLUMN_REMINDER
+	GL_COLUMN_REMINDER,
+	GL_COLUMN_HASH,
+	GL_COLUMN_DONE_COUNT,
+	GL_COLUMN_TOTAL_COUNT,
+	GL_COLUMN_SORT_KEY,
+	GL_COLUMN_ID,
+	GL_N_COLUMNS
 } GlistaColumn;
 
 #define __GLISTA_H
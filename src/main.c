@@ -26,6 +26,7 @@
 #include "glista.h"
 #include "glista-ui.h"
 #include "glista-storage.h"
+#include "glista-item-store.h"
 #include "glista-unique.h"
 #include "glista-reminder.h"
 #include "glista-plugin.h"
@@ -34,9 +35,83 @@
 #include <gtkspell/gtkspell.h>
 #endif
 
-static gboolean (*glista_dnd_old_drag_data_received)(
-	GtkTreeDragDest *drag_dest, GtkTreePath *dest, 
-	GtkSelectionData *selection_data);
+/**
+ * Bulk mutation state: nesting depth of bulk mutations, whether the list was
+ * changed during the current bulk mutation, and number of active sort 
+ * suspensions
+ */
+static guint    bulk_depth     = 0;
+static gboolean bulk_changed   = FALSE;
+static guint    sort_suspended = 0;
+
+/**
+ * Highest item ID assigned or loaded so far. New rows get the next ID.
+ */
+static guint64  last_item_id   = 0;
+
+/**
+ * Items changed since the last save, keyed by ID. Each ID is mapped to the 
+ * content hash the item had when it was last saved, or to 0 if it is new, so 
+ * that saving only has to look at the items which changed.
+ */
+static GHashTable *save_changed = NULL;
+
+/**
+ * Set when saving failed, so that what is on disk may be out of sync with the
+ * list, and the next save has to write all items
+ */
+static gboolean    save_full    = FALSE;
+
+/**
+ * Save state: a save is in flight while the writer thread is working on a 
+ * snapshot of the list. If another save is requested meanwhile, it becomes 
+ * pending and is started as soon as the writer is done.
+ */
+typedef enum {
+	GLISTA_SAVE_IDLE,
+	GLISTA_SAVE_IN_FLIGHT,
+	GLISTA_SAVE_PENDING
+} GlistaSaveState;
+
+/**
+ * A job for the writer thread
+ */
+typedef struct {
+	GList    *deleted;   // Content hashes of changed items, as last saved
+	GList    *inserted;  // Copies of changed items, as they are now
+	GList    *all_items; // Copies of all items, if all have to be saved
+	gboolean  quit;      // Stop the writer thread after saving
+	gboolean  saved;     // Whether the changes were saved, set when done
+	guint     duration;  // Time saving took in ms, set when done
+} GlistaSaveJob;
+
+static GlistaSaveState  save_state       = GLISTA_SAVE_IDLE;
+static GThread         *save_thread      = NULL;
+static GAsyncQueue     *save_queue       = NULL;
+static GMutex          *save_mutex       = NULL;
+static GCond           *save_cond        = NULL;
+static gboolean         save_thread_done = FALSE;
+static gboolean         save_dirty       = FALSE;
+
+// Adaptive save scheduling - all times are in ms
+static guint            save_window        = GLISTA_SAVE_TIMEOUT;
+static guint            save_last_duration = 0;
+static guint            save_avg_duration  = 0;
+static GTimeVal         save_first_change  = { 0, 0 };
+
+static gboolean glista_list_save_done_cb(gpointer user_data);
+
+/**
+ * Progressive loading state. The list is loaded in chunks from an idle 
+ * callback. Categorized and done items are deferred and added last.
+ */
+static GlistaStorageLoader *load_loader        = NULL;
+static GQueue              *load_deferred_cat  = NULL;
+static GQueue              *load_deferred_done = NULL;
+static guint                load_tag           = 0;
+static guint                load_count         = 0;
+static gchar               *load_title         = NULL;
+static gboolean             load_dirty         = FALSE;
 
 /**
  * Glista main program functions
@@ -110,11 +185,11 @@ glista_note_store_in_model()
 			note = g_strstrip(note);
 			
 			if (strlen(note) == 0) {
-				gtk_tree_store_set(gl_globs->itemstore, gl_globs->open_note, 
-								   GL_COLUMN_NOTE, NULL, -1);
+				glista_item_store_set(gl_globs->itemstore, gl_globs->open_note, 
+								      GL_COLUMN_NOTE, NULL, -1);
 			} else {
-				gtk_tree_store_set(gl_globs->itemstore, gl_globs->open_note, 
-								   GL_COLUMN_NOTE, note, -1);
+				glista_item_store_set(gl_globs->itemstore, gl_globs->open_note, 
+								      GL_COLUMN_NOTE, note, -1);
 			}
 		}
 		
@@ -296,31 +371,164 @@ glista_note_toggle_selected(GtkTreeSelection *selection)
 void
 glista_note_clear_selected()
 {
-	GList   *selected, *node;
+	GList *selected, *node;
 	
 	// Iterate over list of selected rows
-	selected = glista_list_get_selected();	
+	selected = glista_list_get_selected_iters();
 	for (node = selected; node != NULL; node = node->next) {
-	    GtkTreePath *path;
+		glista_item_store_set(GL_ITEMSTS, (GtkTreeIter *) node->data, 
+		                      GL_COLUMN_NOTE, NULL, -1);
+		g_free(node->data);
+	}
+	
+	g_list_free(selected);
+}
 
-        path = gtk_tree_row_reference_get_path(
-			(GtkTreeRowReference *)node->data
-		);
-		
-        if (path) {
-        	GtkTreeIter iter;
-	        if (gtk_tree_model_get_iter(GL_ITEMSTM, &iter, path)) {
-				gtk_tree_store_set(GL_ITEMSTS, &iter, 
-								   GL_COLUMN_NOTE, NULL, -1);
-			}
+/**
+ * glista_item_get_sort_key:
+ * @text:   Text of the row
+ * @done:   Whether the row is done
+ * @is_cat: Whether the row is a category
+ *
+ * Build the key a row is sorted by: a flag putting categories first and done
+ * items last, followed by the collation key of the text. Keys can be compared
+ * using strcmp(), and only need to be rebuilt when the text or the done flag 
+ * of the row change.
+ *
+ * Returns: Newly allocated sort key
+ */
+static gchar*
+glista_item_get_sort_key(const gchar *text, gboolean done, gboolean is_cat)
+{
+	gchar *collate_key, *sort_key;
+	gchar  flag;
+	
+	flag = (is_cat ? '0' : (done ? '2' : '1'));
+	
+	collate_key = g_utf8_collate_key((text != NULL ? text : ""), -1);
+	sort_key = g_strdup_printf("%c%s", flag, collate_key);
+	g_free(collate_key);
+	
+	return sort_key;
+}
 
-			gtk_tree_path_free(path);
-        }
+/**
+ * glista_item_new_id:
+ * @id: Requested ID, or 0 to assign a new one
+ *
+ * Pick the ID of a row being added to the list. The requested ID is kept 
+ * unless it is already taken by another row, so that loaded items keep their
+ * stored IDs.
+ *
+ * Returns: An ID which is not used by any row in the list
+ */
+static guint64
+glista_item_new_id(guint64 id)
+{
+	if (id == 0 || g_hash_table_lookup(gl_globs->items, &id) != NULL) {
+		id = ++last_item_id;
+	} else if (id > last_item_id) {
+		last_item_id = id;
 	}
 	
-	// Free the list of selected rows
-	g_list_foreach(selected, (GFunc) gtk_tree_row_reference_free, NULL);
-	g_list_free (selected);
+	return id;
+}
+
+/**
+ * glista_item_changed:
+ * @id:         ID of an item which was changed, added or removed
+ * @saved_hash: Content hash of the item before it was changed, or 0 if the
+ *              item was just added
+ *
+ * Mark an item as changed, so that it is saved with the next save. Only the 
+ * first change since the last save counts, as the content hash the item had
+ * then is the one which was saved.
+ */
+static void
+glista_item_changed(guint64 id, guint64 saved_hash)
+{
+	if (save_changed == NULL) {
+		save_changed = glista_storage_hash_table_new(g_free);
+	}
+	
+	if (g_hash_table_lookup(save_changed, &id) == NULL) {
+		g_hash_table_insert(save_changed, g_memdup(&id, sizeof(guint64)), 
+		                    g_memdup(&saved_hash, sizeof(guint64)));
+	}
+}
+
+/**
+ * glista_item_get_iter:
+ * @id:   Item ID
+ * @iter: Iterator to set to the row of the item
+ *
+ * Find the row of an item or a category by its ID. Item store iterators stay
+ * valid for as long as their row exists, so this is a single hash lookup.
+ *
+ * Returns: TRUE if @iter was set, FALSE if there is no such item
+ */
+gboolean
+glista_item_get_iter(guint64 id, GtkTreeIter *iter)
+{
+	GtkTreeIter *row;
+	
+	if ((row = g_hash_table_lookup(gl_globs->items, &id)) == NULL) {
+		return FALSE;
+	}
+	
+	*iter = *row;
+	return TRUE;
+}
+
+/**
+ * glista_item_index:
+ * @iter: Iterator pointing to a row
+ *
+ * Point the ID of a row to @iter in the item index. Must be called whenever a
+ * row is added, or copied to a new place, as when it is dragged.
+ */
+void
+glista_item_index(GtkTreeIter *iter)
+{
+	guint64 id;
+	
+	gtk_tree_model_get(GL_ITEMSTM, iter, GL_COLUMN_ID, &id, -1);
+	g_hash_table_replace(gl_globs->items, g_memdup(&id, sizeof(guint64)), 
+	                     gtk_tree_iter_copy(iter));
+}
+
+/**
+ * glista_item_unindex:
+ * @iter: Iterator pointing to a row about to be removed
+ *
+ * Remove a row, and the rows under it, from the item index, and mark the 
+ * items as changed. An ID which was already pointed to a copy of the row is 
+ * left as is.
+ */
+void
+glista_item_unindex(GtkTreeIter *iter)
+{
+	GtkTreeIter *row, child;
+	guint64      id, hash;
+	gboolean     is_cat;
+	
+	if (gtk_tree_model_iter_children(GL_ITEMSTM, &child, iter)) {
+		do {
+			glista_item_unindex(&child);
+		} while (gtk_tree_model_iter_next(GL_ITEMSTM, &child));
+	}
+	
+	gtk_tree_model_get(GL_ITEMSTM, iter, GL_COLUMN_ID, &id, 
+	                                     GL_COLUMN_CATEGORY, &is_cat,
+	                                     GL_COLUMN_HASH, &hash, -1);
+	if (! is_cat) {
+		glista_item_changed(id, hash);
+	}
+	
+	row = g_hash_table_lookup(gl_globs->items, &id);
+	if (row != NULL && row->user_data == iter->user_data) {
+		g_hash_table_remove(gl_globs->items, &id);
+	}
 }
 
 /**
@@ -335,80 +543,234 @@ glista_note_clear_selected()
 GtkTreePath*
 glista_category_get_path(gchar *key)
 {
-	GtkTreeRowReference *rowref;
-	GtkTreeIter          iter;
-	GtkTreePath         *path;
-	gchar               *key_c;
+	guint64     *id;
+	GtkTreeIter  iter;
+	gchar       *key_c, *sort_key;
 	
 	key_c = g_utf8_strdown (key, -1);
-	rowref = g_hash_table_lookup(gl_globs->categories, key_c);
-
+	id = g_hash_table_lookup(gl_globs->categories, key_c);
 	
-	if (rowref == NULL) { // Category doesn't exist yet
-		// Add category
-		gtk_tree_store_append(gl_globs->itemstore, &iter, NULL);
-		gtk_tree_store_set(gl_globs->itemstore, &iter, 
-						   GL_COLUMN_TEXT, key, 
-						   GL_COLUMN_CATEGORY, TRUE,
-						   -1);
+	if (id == NULL) { // Category doesn't exist yet
+		// Add category. Categories are not stored, so their IDs do not 
+		// persist between runs.
+		id = g_new(guint64, 1);
+		*id = glista_item_new_id(0);
+		
+		sort_key = glista_item_get_sort_key(key, FALSE, TRUE);
+		glista_item_store_append(gl_globs->itemstore, &iter, NULL);
+		glista_item_store_set(gl_globs->itemstore, &iter, 
+						      GL_COLUMN_TEXT, key, 
+						      GL_COLUMN_CATEGORY, TRUE,
+						      GL_COLUMN_SORT_KEY, sort_key,
+						      GL_COLUMN_ID, *id,
+						      -1);
+		g_free(sort_key);
 		
-		// Add row reference to categories hash table
-		path = gtk_tree_model_get_path(GL_ITEMSTM, &iter);
-		rowref = gtk_tree_row_reference_new(GL_ITEMSTM, path);
-		g_hash_table_insert(gl_globs->categories, key_c, rowref);
+		// Add category ID to the index and to the categories hash table
+		glista_item_index(&iter);
+		g_hash_table_insert(gl_globs->categories, key_c, id);
 		
 	} else { // Category already exists
-		path = gtk_tree_row_reference_get_path(rowref);
+		glista_item_get_iter(*id, &iter);
 		g_free(key_c);
 	}
 	
-	return path;
+	return gtk_tree_model_get_path(GL_ITEMSTM, &iter);
 }
 
 /**
- * glista_list_add:
- * @text: Item text
+ * glista_list_sort_suspend:
  *
- * Adds an additional to-do item to the list. The item text must be provided, 
- * and all other values (done, color, etc.) are set to default values. Text
- * is stripped of leading and trailing spaces, and empty strings are ignored.
+ * Stop sorting the list, so that rows are not moved on each insert and 
+ * change. Rows are kept in insertion order until glista_list_sort_resume() 
+ * is called as many times as this function was called.
+ */
+static void
+glista_list_sort_suspend()
+{
+	if (sort_suspended++ == 0) {
+		gtk_tree_sortable_set_sort_column_id(
+			GTK_TREE_SORTABLE(gl_globs->itemstore), 
+			GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID, GTK_SORT_ASCENDING);
+	}
+}
+
+/**
+ * glista_list_sort_resume:
+ *
+ * Resume sorting the list, sorting it once if no other suspension is active
+ */
+static void
+glista_list_sort_resume()
+{
+	g_return_if_fail(sort_suspended > 0);
+	
+	if (--sort_suspended == 0) {
+		gtk_tree_sortable_set_sort_column_id(
+			GTK_TREE_SORTABLE(gl_globs->itemstore), GL_COLUMN_DONE, 
+			GTK_SORT_ASCENDING);
+	}
+}
+
+/**
+ * glista_list_update_counts:
+ *
+ * Update the item counts of all categories in the list
+ */
+static void
+glista_list_update_counts()
+{
+	GtkTreeIter iter;
+	gboolean    is_cat;
+	
+	if (gtk_tree_model_get_iter_first(GL_ITEMSTM, &iter)) {
+		do {
+			gtk_tree_model_get(GL_ITEMSTM, &iter, 
+			                   GL_COLUMN_CATEGORY, &is_cat, -1);
+			if (is_cat) glista_category_update_counts(&iter);
+		} while (gtk_tree_model_iter_next(GL_ITEMSTM, &iter));
+	}
+}
+
+/**
+ * glista_list_bulk_begin:
+ *
+ * Start a bulk mutation of the list. Until glista_list_bulk_end() is called,
+ * the list is not sorted and the model change handlers are not called, so 
+ * rows should be inserted in sorted order if possible. Bulk mutations can be
+ * nested.
  */
 void
-glista_list_add(GlistaItem *item, gboolean expand)
+glista_list_bulk_begin()
+{
+	if (bulk_depth++ == 0) {
+		g_signal_handlers_block_by_func(gl_globs->itemstore, 
+		                                on_itemstore_row_changed, NULL);
+		g_signal_handlers_block_by_func(gl_globs->itemstore, 
+		                                on_itemstore_row_inserted, NULL);
+		g_signal_handlers_block_by_func(gl_globs->itemstore, 
+		                                on_itemstore_row_deleted, NULL);
+	}
+	
+	glista_list_sort_suspend();
+}
+
+/**
+ * glista_list_bulk_end:
+ * @changed: Whether the list was changed and needs to be saved
+ *
+ * End a bulk mutation of the list. When the outermost bulk mutation ends, the
+ * list is sorted and redrawn once, and saved if any of the nested bulk 
+ * mutations changed it.
+ */
+void
+glista_list_bulk_end(gboolean changed)
+{
+	g_return_if_fail(bulk_depth > 0);
+	
+	bulk_changed = (bulk_changed || changed);
+	glista_list_sort_resume();
+	
+	if (--bulk_depth == 0) {
+		// Item counts were not kept up to date during the bulk mutation. While
+		// the list is loading, they are only counted once loading is done.
+		if (load_deferred_cat == NULL) {
+			glista_list_update_counts();
+		}
+		
+		g_signal_handlers_unblock_by_func(gl_globs->itemstore, 
+		                                  on_itemstore_row_changed, NULL);
+		g_signal_handlers_unblock_by_func(gl_globs->itemstore, 
+		                                  on_itemstore_row_inserted, NULL);
+		g_signal_handlers_unblock_by_func(gl_globs->itemstore, 
+		                                  on_itemstore_row_deleted, NULL);
+		
+		gtk_widget_queue_draw(glista_get_widget("glista_item_list"));
+		
+		if (bulk_changed) {
+			bulk_changed = FALSE;
+			glista_list_save_timeout();
+		}
+	}
+}
+
+/**
+ * glista_list_insert:
+ * @item:   The item to insert
+ * @expand: Whether to expand the category of the item
+ *
+ * Insert an item into the list, without marking it as changed. The item keeps
+ * its ID unless it is taken already.
+ *
+ * Returns: The ID of the inserted row
+ */
+static guint64
+glista_list_insert(GlistaItem *item, gboolean expand)
 {
-	GtkTreeIter          iter, parent_iter;
-	GtkTreePath         *parent, *path;
-	GtkTreeRowReference *ref;
+	GtkTreeIter  iter, parent_iter;
+	GtkTreePath *parent;
+	GlistaItem   stored;
+	gchar       *sort_key;
+	
+	// The ID is part of the content hash, so hash the item as it is stored
+	stored = *item;
+	stored.id = glista_item_new_id(item->id);
 	
 	if (item->parent == NULL) {
-		gtk_tree_store_append(gl_globs->itemstore, &iter, NULL);
+		glista_item_store_append(gl_globs->itemstore, &iter, NULL);
 		
 	} else {
 		parent = glista_category_get_path(item->parent);		
 		gtk_tree_model_get_iter(GL_ITEMSTM, &parent_iter, parent);
-		gtk_tree_store_append(gl_globs->itemstore, &iter, &parent_iter);
+		glista_item_store_append(gl_globs->itemstore, &iter, &parent_iter);
 		
 		// Expand parent so that new child is visible
 		if (expand) gtk_tree_view_expand_row(
 			GTK_TREE_VIEW(glista_get_widget("glista_item_list")), parent, TRUE);
+		
+		gtk_tree_path_free(parent);
 	}
 	
-	gtk_tree_store_set(GL_ITEMSTS, &iter, 
-	                   GL_COLUMN_DONE, item->done, 
-	                   GL_COLUMN_TEXT, item->text, 
-	                   GL_COLUMN_NOTE, item->note,
-					   -1);
+	sort_key = glista_item_get_sort_key(item->text, item->done, FALSE);
+	
+	glista_item_store_set(GL_ITEMSTS, &iter, 
+	                      GL_COLUMN_DONE, item->done, 
+	                      GL_COLUMN_TEXT, item->text, 
+	                      GL_COLUMN_NOTE, item->note,
+	                      GL_COLUMN_HASH, glista_storage_item_hash(&stored),
+	                      GL_COLUMN_SORT_KEY, sort_key,
+	                      GL_COLUMN_ID, stored.id,
+					      -1);
+	
+	g_free(sort_key);
+	glista_item_index(&iter);
+	
+	// The category counted the item as not done when it was appended. Counts
+	// are not kept up to date during bulk mutations.
+	if (item->done && item->parent != NULL && bulk_depth == 0) {
+		glista_category_adjust_counts(&parent_iter, 1, 0);
+	}
 	
 	// If we have a reminder set
 	if (item->remind_at != -1) {
-		path = gtk_tree_model_get_path(GL_ITEMSTM, &iter);
-		ref = gtk_tree_row_reference_new(GL_ITEMSTM, path);
-		
-		glista_reminder_set(ref, item->remind_at);
-		
-		gtk_tree_path_free(path);
-		gtk_tree_row_reference_free(ref);
+		glista_reminder_set(stored.id, item->remind_at, item->repeat);
 	}
+	
+	return stored.id;
+}
+
+/**
+ * glista_list_add:
+ * @text: Item text
+ *
+ * Adds an additional to-do item to the list. The item text must be provided, 
+ * and all other values (done, color, etc.) are set to default values. Text
+ * is stripped of leading and trailing spaces, and empty strings are ignored.
+ */
+void
+glista_list_add(GlistaItem *item, gboolean expand)
+{
+	glista_item_changed(glista_list_insert(item, expand), 0);
 }
 
 /**
@@ -463,66 +825,235 @@ glista_item_create_from_text(gchar *text)
 void 
 glista_item_toggle_done(GtkTreePath *path)
 {
-	GtkTreeIter  iter;
+	GtkTreeIter  iter, parent_iter;
 	gboolean     current; 
+	gchar       *text, *sort_key;
 
 	if (gtk_tree_model_get_iter(GL_ITEMSTM, &iter, path)) {
-		gtk_tree_model_get(GL_ITEMSTM, &iter, GL_COLUMN_DONE, &current, -1);
-		gtk_tree_store_set(gl_globs->itemstore, &iter, GL_COLUMN_DONE, 
-		                   (! current), -1);
+		gtk_tree_model_get(GL_ITEMSTM, &iter, GL_COLUMN_DONE, &current, 
+		                                      GL_COLUMN_TEXT, &text, -1);
+		
+		sort_key = glista_item_get_sort_key(text, (! current), FALSE);
+		glista_item_store_set(gl_globs->itemstore, &iter, 
+		                      GL_COLUMN_DONE, (! current), 
+		                      GL_COLUMN_SORT_KEY, sort_key, -1);
+		
+		// Update the done count of the category, if any
+		if (gtk_tree_model_iter_parent(GL_ITEMSTM, &parent_iter, &iter)) {
+			glista_category_adjust_counts(&parent_iter, (current ? -1 : 1), 0);
+		}
+		
+		g_free(sort_key);
+		g_free(text);
+	}
+}
+
+/**
+ * glista_item_get_hash:
+ * @iter: Iterator pointing to an item
+ *
+ * Calculate the content hash of an item in the list, from its persistent 
+ * properties only. The row is read in place, nothing is copied out of the 
+ * model but the recurrence rule of its reminder, if any.
+ *
+ * Returns: 64 bit content hash, as calculated by glista_storage_item_hash()
+ */
+static guint64
+glista_item_get_hash(GtkTreeIter *iter)
+{
+	GlistaItemRow  *row = GLISTA_ITEM_STORE_ROW(iter);
+	GlistaReminder *reminder = (GlistaReminder *) row->reminder;
+	GlistaItem      item;
+	guint64         hash;
+	
+	item.id        = row->id;
+	item.done      = row->done;
+	item.text      = row->text;
+	item.note      = row->note;
+	item.parent    = (row->parent == NULL ? NULL : row->parent->text);
+	item.remind_at = (reminder == NULL ? -1 : reminder->remind_at);
+	item.repeat    = (reminder == NULL ? NULL : 
+	                  glista_reminder_get_repeat(reminder));
+	
+	hash = glista_storage_item_hash(&item);
+	
+	g_free(item.repeat);
+	
+	return hash;
+}
+
+/**
+ * glista_item_update_hash:
+ * @iter: Iterator pointing to a changed row
+ *
+ * Check whether a change to a row altered any of its persistent properties, 
+ * and if so mark the item as changed. Redraws, and changes to columns which 
+ * are not saved, leave the content hash of the row as is. Category rows are 
+ * never saved by themselves, and are never considered changed.
+ *
+ * Returns: TRUE if the row needs to be saved, FALSE otherwise
+ */
+gboolean
+glista_item_update_hash(GtkTreeIter *iter)
+{
+	GlistaItemRow *row = GLISTA_ITEM_STORE_ROW(iter);
+	guint64        old_hash, hash;
+	
+	if (row->category) return FALSE;
+	
+	hash = glista_item_get_hash(iter);
+	if (hash == row->hash) return FALSE;
+	
+	// The content hash is neither shown nor sorted on, so it is stored in 
+	// place, without another "row-changed" round
+	old_hash  = row->hash;
+	row->hash = hash;
+	
+	glista_item_changed(row->id, old_hash);
+	
+	return TRUE;
+}
+
+/**
+ * glista_category_update_counts:
+ * @category: Iterator pointing to a category row
+ *
+ * Count the done items and the total items in a category, and store them in 
+ * the category row, so that they do not need to be counted whenever the 
+ * category row is drawn. The category row is only changed, and thus redrawn,
+ * if any of the counts changed. Only used after bulk mutations, single 
+ * changes adjust the counts with glista_category_adjust_counts().
+ */
+void
+glista_category_update_counts(GtkTreeIter *category)
+{
+	GtkTreeIter child;
+	gboolean    done;
+	guint       done_c = 0, total_c = 0, old_done_c, old_total_c;
+	
+	if (gtk_tree_model_iter_children(GL_ITEMSTM, &child, category)) {
+		do {
+			gtk_tree_model_get(GL_ITEMSTM, &child, GL_COLUMN_DONE, &done, -1);
+			if (done) done_c++;
+			total_c++;
+		} while (gtk_tree_model_iter_next(GL_ITEMSTM, &child));
+	}
+	
+	gtk_tree_model_get(GL_ITEMSTM, category, 
+	                   GL_COLUMN_DONE_COUNT, &old_done_c,
+	                   GL_COLUMN_TOTAL_COUNT, &old_total_c, -1);
+	
+	if (done_c != old_done_c || total_c != old_total_c) {
+		glista_item_store_set(GL_ITEMSTS, category, 
+		                      GL_COLUMN_DONE_COUNT, done_c,
+		                      GL_COLUMN_TOTAL_COUNT, total_c, -1);
 	}
 }
 
 /**
- * glista_item_redraw_parent: 
+ * glista_category_adjust_counts:
+ * @category: Iterator pointing to a category row
+ * @done:     Change in the number of done items
+ * @total:    Change in the total number of items
+ *
+ * Adjust the item counts stored in a category row as a single item is added,
+ * removed or toggled, without counting all items in the category. Changing 
+ * the counts triggers a redraw of the category row.
+ */
+void
+glista_category_adjust_counts(GtkTreeIter *category, gint done, gint total)
+{
+	guint done_c, total_c;
+	
+	if (done == 0 && total == 0) return;
+	
+	gtk_tree_model_get(GL_ITEMSTM, category, 
+	                   GL_COLUMN_DONE_COUNT, &done_c,
+	                   GL_COLUMN_TOTAL_COUNT, &total_c, -1);
+	
+	done_c  = (guint) MAX(0, (gint) done_c + done);
+	total_c = (guint) MAX(0, (gint) total_c + total);
+	
+	glista_item_store_set(GL_ITEMSTS, category, 
+	                      GL_COLUMN_DONE_COUNT, done_c,
+	                      GL_COLUMN_TOTAL_COUNT, total_c, -1);
+}
+
+/**
+ * glista_item_count_in_parent: 
  * @child_iter: Iterator pointing to the child element
+ * @count:      1 if the item was added to its parent, -1 if it is about to be
+ *              removed from it
  *
- * Takes in a pointer to a modified row, and if it has a parent, will trigger
- * a redraw of the parent by calling gtk_tree_model_row_changed() on the parent.
+ * Takes in a pointer to an added or removed row, and if it has a parent, will
+ * update the item counts of the parent, which triggers a redraw of the 
+ * parent.
  */
 void
-glista_item_redraw_parent(GtkTreeIter *child_iter)
+glista_item_count_in_parent(GtkTreeIter *child_iter, gint count)
 {
-	GtkTreeIter  parent_iter;
-	GtkTreePath *parent_path;
+	GtkTreeIter parent_iter;
+	gboolean    done;
 	
 	// Check if item has a parent
 	if (gtk_tree_model_iter_parent(GL_ITEMSTM, &parent_iter, child_iter)) {
-		
-		parent_path = gtk_tree_model_get_path(GL_ITEMSTM, &parent_iter);
-		
-		// Trigger a "row-changed" signal on tha prent as well
-		gtk_tree_model_row_changed(GL_ITEMSTM, parent_path, &parent_iter);
-									   
-		gtk_tree_path_free(parent_path);
+		gtk_tree_model_get(GL_ITEMSTM, child_iter, GL_COLUMN_DONE, &done, -1);
+		glista_category_adjust_counts(&parent_iter, (done ? count : 0), count);
 	}
 }
 
 /**
- * glista_category_delete:
- * @category: The GtkTreeIter of the category row to remove 
+ * glista_category_detach:
+ * @category: The GtkTreeIter of a category row about to be removed
  *
- * deletes a gategory, including all it's child items, from the tree model and
- * from the categories hash table
+ * Remove a category from the categories hash table and from the item index,
+ * and drop the reminders of all its child items. The row itself is left in 
+ * the model for the caller to remove.
  */
-void 
-glista_category_delete(GtkTreeIter *category)
+static void
+glista_category_detach(GtkTreeIter *category)
 {
-	gchar               *cat_name, *key;
-	GtkTreeRowReference *rowref;
+	gchar          *cat_name, *key;
+	GtkTreeIter     child;
+	GlistaReminder *reminder;
 	
 	// Get the name of the category we are deleting
 	gtk_tree_model_get(GL_ITEMSTM, category, GL_COLUMN_TEXT, &cat_name, -1);
 	
 	// Remove category from categories hashtable
 	key = g_utf8_strdown (cat_name, -1);
-	if ((rowref = g_hash_table_lookup(gl_globs->categories, key)) != NULL) {
-		g_hash_table_remove(gl_globs->categories, key);
-	}
+	g_hash_table_remove(gl_globs->categories, key);
 	g_free(key);
 	
-	// Remove category from model
-	gtk_tree_store_remove(gl_globs->itemstore, category);
+	g_free(cat_name);
+	
+	// Drop the reminders of all items in the category
+	if (gtk_tree_model_iter_children(GL_ITEMSTM, &child, category)) {
+		do {
+			gtk_tree_model_get(GL_ITEMSTM, &child, 
+			                   GL_COLUMN_REMINDER, &reminder, -1);
+			if (reminder != NULL) {
+				glista_reminder_remove(reminder);
+			}
+		} while (gtk_tree_model_iter_next(GL_ITEMSTM, &child));
+	}
+	
+	// Remove category from the index
+	glista_item_unindex(category);
+}
+
+/**
+ * glista_category_delete:
+ * @category: The GtkTreeIter of the category row to remove 
+ *
+ * deletes a gategory, including all it's child items and their reminders, 
+ * from the tree model and from the categories hash table
+ */
+void 
+glista_category_delete(GtkTreeIter *category)
+{
+	glista_category_detach(category);
+	glista_item_store_remove(gl_globs->itemstore, category);
 }
 
 /**
@@ -530,9 +1061,11 @@ glista_category_delete(GtkTreeIter *category)
  * @category: A GtkTreeIter pointing to the category to delete
  *
  * Show a message dialog confirming the deletion of a category with all it's
- * child items. If the user approves, will call glista_category_delete().
+ * child items. Empty categories are deleted without asking.
+ *
+ * Returns: TRUE if the category should be deleted, FALSE otherwise
  */
-void
+static gboolean
 glista_category_confirm_delete(GtkTreeIter *category) 
 {
 	gchar            *cat_name;
@@ -554,188 +1087,388 @@ glista_category_confirm_delete(GtkTreeIter *category)
 		
 		response = gtk_dialog_run(GTK_DIALOG(dialog));
 		gtk_widget_destroy(dialog);
+		g_free(cat_name);
 		
 		// Delete category only if confirmed
-		if (response == GTK_RESPONSE_OK) {
-			glista_category_delete (category);
-		}
+		return (response == GTK_RESPONSE_OK);
 										
 	} else {
 		// If it has no children, just delete it
-		glista_category_delete (category);	
+		return TRUE;
 	}	
 }
 
 /**
- * glista_item_delete: 
- * @iter: Iterator pointing to the item to delete
+ * A reminder change in a batch
+ */
+typedef struct {
+	GtkTreeIter iter;      // The item or category to set the reminder on
+	time_t      remind_at; // Time to remind at, or -1 to clear the reminder
+	gchar      *repeat;    // Recurrence rule, or NULL
+} GlistaBatchReminder;
+
+/**
+ * glista_batch_new:
+ *
+ * Start a new batch of list mutations. Mutations are collected by calling
+ * glista_batch_delete() and glista_batch_set_reminder(), and are applied at
+ * once by glista_batch_commit(). Rows are held as iterators, which stay 
+ * valid while the batch is collected as long as the list is not changed.
+ *
+ * Returns: A new, empty batch
+ */
+GlistaBatch*
+glista_batch_new()
+{
+	GlistaBatch *batch;
+	
+	batch = g_new0(GlistaBatch, 1);
+	batch->deletes = g_hash_table_new_full(g_direct_hash, g_direct_equal, 
+	                                       NULL, g_free);
+	
+	return batch;
+}
+
+/**
+ * glista_batch_delete:
+ * @batch: The batch
+ * @iter:  Iterator pointing to the item or category to delete
  *
- * Delete an item (not a category) from the list. If item is in a category and
- * the category becomes empty, the parent category will also be deleted. 
+ * Add a row to the rows deleted by a batch. Deleting a category deletes all 
+ * the items in it. Adding the same row more than once has no effect.
  */
 void
-glista_item_delete(GtkTreeIter *iter)
+glista_batch_delete(GlistaBatch *batch, GtkTreeIter *iter)
+{
+	// Item store iterators point right at the row, which identifies it
+	if (g_hash_table_lookup(batch->deletes, iter->user_data) == NULL) {
+		g_hash_table_insert(batch->deletes, iter->user_data, 
+		                    g_memdup(iter, sizeof(GtkTreeIter)));
+	}
+}
+
+/**
+ * glista_batch_set_reminder:
+ * @batch:     The batch
+ * @iter:      Iterator pointing to an item or a category
+ * @remind_at: Time to remind at, or -1 to clear the reminder
+ * @repeat:    Recurrence rule, or NULL if the reminder does not repeat
+ *
+ * Add a reminder change to a batch. Setting a reminder on a category sets it
+ * on all the items in it. Any existing reminder on the item is replaced.
+ */
+void
+glista_batch_set_reminder(GlistaBatch *batch, GtkTreeIter *iter, 
+                          time_t remind_at, const gchar *repeat)
+{
+	GlistaBatchReminder *change;
+	
+	change = g_new(GlistaBatchReminder, 1);
+	change->iter = *iter;
+	change->remind_at = remind_at;
+	change->repeat = g_strdup(repeat);
+	
+	batch->reminders = g_list_prepend(batch->reminders, change);
+}
+
+/**
+ * glista_batch_reminder_free:
+ * @change: The reminder change to free
+ *
+ * Free a reminder change of a batch
+ */
+static void
+glista_batch_reminder_free(GlistaBatchReminder *change)
+{
+	g_free(change->repeat);
+	g_free(change);
+}
+
+/**
+ * glista_batch_free:
+ * @batch: The batch to free
+ *
+ * Free a batch without applying it
+ */
+void
+glista_batch_free(GlistaBatch *batch)
+{
+	g_hash_table_destroy(batch->deletes);
+	g_list_foreach(batch->reminders, (GFunc) glista_batch_reminder_free, NULL);
+	g_list_free(batch->reminders);
+	g_free(batch);
+}
+
+/**
+ * glista_batch_apply_reminder:
+ * @change: The reminder change to apply
+ *
+ * Replace the reminder of an item, or of all the items in a category. The
+ * change handlers are blocked during batches, so changed items are marked as
+ * changed here.
+ */
+static void
+glista_batch_apply_reminder(GlistaBatchReminder *change)
 {
-	gboolean        has_parent;
-	GtkTreeIter     parent;
 	GlistaReminder *reminder;
+	GtkTreeIter     child;
+	guint64         id;
 	
-	// Check if this item has a parent category
-	has_parent = gtk_tree_model_iter_parent(GL_ITEMSTM, &parent, iter);
+	if (gtk_tree_model_iter_children(GL_ITEMSTM, &child, &change->iter)) {
+		glista_reminder_set_category(&change->iter, change->remind_at, 
+		                             change->repeat);
+		do {
+			glista_item_update_hash(&child);
+		} while (gtk_tree_model_iter_next(GL_ITEMSTM, &child));
+		
+		return;
+	}
 	
-	// Check if this item has a reminder set - if so remove it
-	gtk_tree_model_get(GL_ITEMSTM, iter, GL_COLUMN_REMINDER, &reminder, -1);
+	// Drop the current reminder, if any
+	gtk_tree_model_get(GL_ITEMSTM, &change->iter, 
+	                   GL_COLUMN_REMINDER, &reminder, 
+	                   GL_COLUMN_ID, &id, -1);
 	if (reminder != NULL) {
-		glista_reminder_remove(reminder);	
+		glista_reminder_remove(reminder);
+		glista_item_store_set(GL_ITEMSTS, &change->iter, 
+		                      GL_COLUMN_REMINDER, NULL, -1);
 	}
 	
-	// Remove item
-	gtk_tree_store_remove(gl_globs->itemstore, iter);
-	
-	// Check if parent is now empty
-	if (has_parent && gtk_tree_model_iter_n_children(GL_ITEMSTM, &parent) < 1) {
-		
-		// Delete parent as well
-		glista_category_delete(&parent);
+	if (change->remind_at != -1) {
+		glista_reminder_set(id, change->remind_at, change->repeat);
 	}
+	
+	glista_item_update_hash(&change->iter);
 }
-				   
+
+/**
+ * A category items are deleted from by a batch
+ */
+typedef struct {
+	GtkTreeIter iter;
+	gint        deleted; // Number of items deleted from the category
+} GlistaBatchParent;
+
 /**
- * glista_list_delete_reflist:
- * @ref_list: A linked list of items to delete
+ * State of a batch being committed
+ */
+typedef struct {
+	GlistaBatch *batch;
+	GHashTable  *parents;    // Categories items were deleted from
+	GList       *categories; // Categories to delete
+	GList       *rows;       // Rows to remove from the model
+} GlistaBatchCommit;
+
+/**
+ * glista_batch_delete_item_cb:
+ * @key:    The tree node of the row
+ * @iter:   Iterator pointing to the row to delete
+ * @commit: The commit state
  *
- * Delete all items passed in in a linked list. This function is called from 
- * other deletion functions to clear out selected or done items. It does not 
- * free the list of items for now. 
- * 
- * If the list contains a category that still has items in it, it will confirm
- * with the user first before deleting.
+ * Prepare an item in a batch for deletion, and count it in the category it
+ * is in. Categories are only collected, and are prepared once all items are.
  */
-static void 
-glista_list_delete_reflist(GList *ref_list)
+static void
+glista_batch_delete_item_cb(gpointer key, GtkTreeIter *iter, 
+                            GlistaBatchCommit *commit)
 {
-	GList *node;
+	GtkTreeIter        parent;
+	GlistaBatchParent *counted;
+	GlistaReminder    *reminder;
+	gboolean           is_cat;
 	
-	for (node = ref_list; node != NULL; node = node->next) {
-	    GtkTreePath *path;
-
-        path = gtk_tree_row_reference_get_path(
-			(GtkTreeRowReference *)node->data
-		);
+	gtk_tree_model_get(GL_ITEMSTM, iter, GL_COLUMN_CATEGORY, &is_cat, -1);
+	
+	if (is_cat) {
+		commit->categories = g_list_prepend(commit->categories, iter);
+		return;
+	}
+	
+	if (gtk_tree_model_iter_parent(GL_ITEMSTM, &parent, iter)) {
+		// Items in deleted categories go away with their category
+		if (g_hash_table_lookup(commit->batch->deletes, 
+		                        parent.user_data) != NULL) {
+			return;
+		}
 		
-        if (path) {
-        	GtkTreeIter iter;
-			gboolean    is_cat;
-
-	        if (gtk_tree_model_get_iter(GL_ITEMSTM, &iter, path)) {
-				// Check if this is a category we are deleting
-				gtk_tree_model_get(GL_ITEMSTM, &iter, 
-								   GL_COLUMN_CATEGORY, &is_cat, -1);
-				if (is_cat) {
-					// Show the confirm dialog before deleting any categories
-					glista_category_confirm_delete(&iter);
-					
-				} else {	
-					glista_item_delete(&iter);
-				}
-			}
-
-			gtk_tree_path_free(path);
-        }
+		if ((counted = g_hash_table_lookup(commit->parents, 
+		                                   parent.user_data)) == NULL) {
+			counted = g_new0(GlistaBatchParent, 1);
+			counted->iter = parent;
+			g_hash_table_insert(commit->parents, parent.user_data, counted);
+		}
+		counted->deleted++;
 	}
+	
+	gtk_tree_model_get(GL_ITEMSTM, iter, GL_COLUMN_REMINDER, &reminder, -1);
+	if (reminder != NULL) {
+		glista_reminder_remove(reminder);
+	}
+	
+	glista_item_unindex(iter);
+	commit->rows = g_list_prepend(commit->rows, iter);
 }
 
 /**
- * glista_list_get_selected_cb:
- * @model:    Tree model to iterate on
- * @path:     Current path in tree
- * @iter:     Current iter in tree
- * @ref_list: List to populate with row references
+ * glista_batch_delete_empty_cb:
+ * @key:    The tree node of the category
+ * @parent: A category items were deleted from
+ * @commit: The commit state
  *
- * Callback function for gtk_tree_selection_selected_foreach(). Populates a list
- * of references to all selected rows in the list. 
+ * Prepare a category for deletion if all of its items are deleted
+ */
+static void
+glista_batch_delete_empty_cb(gpointer key, GlistaBatchParent *parent, 
+                             GlistaBatchCommit *commit)
+{
+	if (gtk_tree_model_iter_n_children(GL_ITEMSTM, &parent->iter) == 
+	    parent->deleted) {
+		glista_category_detach(&parent->iter);
+		commit->rows = g_list_prepend(commit->rows, &parent->iter);
+	}
+}
+
+/**
+ * glista_batch_commit:
+ * @batch: The batch to apply, freed by this function
  *
- * This function is called from glista_list_delete_selected() in order to build
- * a list of references to rows to delete, because rows cannot be deleted 
- * directly.
+ * Apply all the mutations collected in a batch, in a single bulk mutation. 
+ * Reminders are changed first, and then rows are deleted: items first, and 
+ * then categories. Categories left empty are deleted along with their items.
+ * All deleted rows are removed from the model at once, and the list is saved
+ * and redrawn once, when done.
  */
-static void 
-glista_list_get_selected_cb(GtkTreeModel *model, GtkTreePath *path,
-								 GtkTreeIter *iter, GList **ref_list)
+void
+glista_batch_commit(GlistaBatch *batch)
 {
-	GtkTreeRowReference *ref;
+	GlistaBatchCommit  commit;
+	GtkTreeIter       *iter;
+	GList             *node;
+	gboolean           changed;
+	
+	changed = (batch->reminders != NULL || 
+	           g_hash_table_size(batch->deletes) > 0);
+	
+	glista_list_bulk_begin();
 	
-	g_assert(ref_list != NULL);
-	ref = gtk_tree_row_reference_new(model, path);
-	*ref_list = g_list_append(*ref_list, ref);
+	// Reminders are applied in the order they were added
+	batch->reminders = g_list_reverse(batch->reminders);
+	for (node = batch->reminders; node != NULL; node = node->next) {
+		glista_batch_apply_reminder((GlistaBatchReminder *) node->data);
+	}
+	
+	// Delete items
+	commit.batch      = batch;
+	commit.categories = NULL;
+	commit.rows       = NULL;
+	commit.parents    = g_hash_table_new_full(g_direct_hash, g_direct_equal, 
+	                                          NULL, g_free);
+	
+	g_hash_table_foreach(batch->deletes, 
+	                     (GHFunc) glista_batch_delete_item_cb, &commit);
+	
+	// Delete categories
+	for (node = commit.categories; node != NULL; node = node->next) {
+		iter = (GtkTreeIter *) node->data;
+		g_hash_table_remove(commit.parents, iter->user_data);
+		glista_category_detach(iter);
+		commit.rows = g_list_prepend(commit.rows, iter);
+	}
+	g_list_free(commit.categories);
+	
+	// Delete categories which are now empty
+	g_hash_table_foreach(commit.parents, 
+	                     (GHFunc) glista_batch_delete_empty_cb, &commit);
+	
+	// Remove all deleted rows from the model in one go
+	glista_item_store_remove_rows(GL_ITEMSTS, commit.rows);
+	g_list_free(commit.rows);
+	g_hash_table_destroy(commit.parents);
+	
+	glista_list_bulk_end(changed);
+	glista_batch_free(batch);
 }
 
 /**
- * glista_list_get_selected:
- * 
- * Populate a GList of references to all selected items (or categories) in the 
- * list. Will use glista_list_get_selected_cb() as a callback function. 
- * 
- * Returns a pointer to the first item of the list
+ * glista_list_get_selected_iters:
+ *
+ * Get iterators pointing to all selected items (or categories) in the list. 
+ * Iterators stay valid for as long as their rows exist, but rows may be 
+ * removed as the list changes, so they should be used before the list is 
+ * changed, for example to build a batch of mutations. To keep track of a row
+ * across changes, keep its ID.
+ *
+ * Returns: A list of newly allocated iterators, to be freed with g_free()
  */
 GList*
-glista_list_get_selected()
+glista_list_get_selected_iters()
 {
 	GtkTreeView      *treeview;
 	GtkTreeSelection *selection;
-	GList            *ref_list;
+	GList            *paths, *node, *iters = NULL;
+	GtkTreeIter       iter;
 	
 	treeview = GTK_TREE_VIEW(glista_get_widget("glista_item_list"));
 	selection = gtk_tree_view_get_selection(treeview);
 	
-	// Populate list of row references to delete
-	ref_list = NULL;
-	gtk_tree_selection_selected_foreach(
-		selection, 
-	    (GtkTreeSelectionForeachFunc) glista_list_get_selected_cb,
-	    &ref_list
-    );
-
-	return ref_list;
+	paths = gtk_tree_selection_get_selected_rows(selection, NULL);
+	for (node = paths; node != NULL; node = node->next) {
+		if (gtk_tree_model_get_iter(GL_ITEMSTM, &iter, 
+		                            (GtkTreePath *) node->data)) {
+			iters = g_list_prepend(iters, 
+			                       g_memdup(&iter, sizeof(GtkTreeIter)));
+		}
+		gtk_tree_path_free((GtkTreePath *) node->data);
+	}
+	g_list_free(paths);
+	
+	return g_list_reverse(iters);
 }
 
 /**
  * glista_list_delete_selected:
  *
- * Delete all selected items from the list. Populates a list of all selected 
- * items (using glista_list_get_selected() and passes it on to 
- * glista_list_delete_reflist() to do the actual deletion.
+ * Delete all selected items from the list, in a single batch. If any of the 
+ * selected rows is a category that still has items in it, the user is asked
+ * to confirm before it is deleted.
  */
 void 
 glista_list_delete_selected()
 {
-	GtkTreeView      *treeview;
-	GList            *ref_list;
+	GlistaBatch *batch;
+	GList       *iters, *node;
+	GtkTreeIter *iter;
+	gboolean     is_cat;
 	
-	treeview = GTK_TREE_VIEW(glista_get_widget("glista_item_list"));
+	batch = glista_batch_new();
+	iters = glista_list_get_selected_iters();
 	
-	// Populate list of row references to delete
-	ref_list = glista_list_get_selected();
+	for (node = iters; node != NULL; node = node->next) {
+		iter = (GtkTreeIter *) node->data;
+		gtk_tree_model_get(GL_ITEMSTM, iter, GL_COLUMN_CATEGORY, &is_cat, -1);
+		
+		// Show the confirm dialog before deleting any categories
+		if ((! is_cat) || glista_category_confirm_delete(iter)) {
+			glista_batch_delete(batch, iter);
+		}
+	}
 	
-	// Delete items
-	glista_list_delete_reflist(ref_list);
-
-	// Free reference list
-	g_list_foreach(ref_list, (GFunc) gtk_tree_row_reference_free, NULL);
-    g_list_free(ref_list);
+	g_list_foreach(iters, (GFunc) g_free, NULL);
+	g_list_free(iters);
+	
+	glista_batch_commit(batch);
 }
 
 /**
- * glista_list_get_done_reflist: 
- * @ref_list a pointer-pointer to the GList to populate
- * @parent   the parent iter when recursing into category children
+ * glista_list_batch_delete_done: 
+ * @batch  The batch to add deleted items to
+ * @parent The parent iter when recursing into category children
  *
- * Populate a list of done items to be deleted. Called internally by 
- * glista_list_delete_done(), which later on calles 
- * glista_list_delete_reflist() to do the actual deletion. 
+ * Add all done items to a batch of items to delete. Called internally by 
+ * glista_list_delete_done().
  */
 static void
-glista_list_get_done_reflist(GList **ref_list, GtkTreeIter *parent)
+glista_list_batch_delete_done(GlistaBatch *batch, GtkTreeIter *parent)
 {
 	GtkTreeIter  iter;
 	gboolean     status;
@@ -745,9 +1478,7 @@ glista_list_get_done_reflist(GList **ref_list, GtkTreeIter *parent)
 
 	// Iterate on all rows
 	while (status) {
-		GtkTreeRowReference *rowref;
-		GtkTreePath         *path;
-		gboolean             is_done, is_cat;				 
+		gboolean is_done, is_cat;				 
 		
 		gtk_tree_model_get(GL_ITEMSTM, &iter, 
 		                   GL_COLUMN_DONE, &is_done,
@@ -756,19 +1487,11 @@ glista_list_get_done_reflist(GList **ref_list, GtkTreeIter *parent)
 		
 		// If it is a category, look into it's child items
 		if (is_cat) {
-			glista_list_get_done_reflist(ref_list, &iter);
+			glista_list_batch_delete_done(batch, &iter);
 		
-		// If it is done, add it to the list of references
+		// If it is done, add it to the batch
 		} else if (is_done) {
-			// Get a reference to the row
-			path = gtk_tree_model_get_path(GL_ITEMSTM, &iter);
-			rowref = gtk_tree_row_reference_new(GL_ITEMSTM, path);
-			
-			// Add reference to the linked list
-			*ref_list = g_list_append(*ref_list, rowref);
-			
-			// Free path
-			gtk_tree_path_free(path);
+			glista_batch_delete(batch, &iter);
 		}
 		
 		// Advance to next row
@@ -776,28 +1499,20 @@ glista_list_get_done_reflist(GList **ref_list, GtkTreeIter *parent)
 	}
 }
 
-
 /**
  * glista_list_delete_done:
  * 
- * Clear off all the items marked as "done" from the list. Normally this is 
- * called when the "Clear" button is activated.
+ * Clear off all the items marked as "done" from the list, in a single batch.
+ * Normally this is called when the "Clear" button is activated.
  */
 void 
 glista_list_delete_done()
 {
-	GList *ref_list;
+	GlistaBatch *batch;
 	
-	// Populate reference list
-	ref_list = NULL;
-	glista_list_get_done_reflist(&ref_list, NULL);
-
-	// Delete items
-	glista_list_delete_reflist(ref_list);
-
-	// Free reference list
-	g_list_foreach(ref_list, (GFunc) gtk_tree_row_reference_free, NULL);
-    g_list_free(ref_list);
+	batch = glista_batch_new();
+	glista_list_batch_delete_done(batch, NULL);
+	glista_batch_commit(batch);
 }
 
 /**
@@ -821,6 +1536,8 @@ glista_category_rename(GtkTreePath *old_path, GtkTreeIter *old_iter,
 	gtk_tree_model_get(GL_ITEMSTM, old_iter, GL_COLUMN_TEXT, &old_name, -1);
 	if (g_strcmp0(old_name, new_name) != 0) {
 		
+		glista_list_bulk_begin();
+		
 		// Create a new category
 		new_cat = glista_category_get_path(new_name);
 		
@@ -828,21 +1545,32 @@ glista_category_rename(GtkTreePath *old_path, GtkTreeIter *old_iter,
 		if (gtk_tree_model_iter_children(GL_ITEMSTM, &child_iter, old_iter)) {
 
 			do {
-				GlistaItem *item;
-				gchar      *item_text, *item_note;
-				gboolean    item_done;
+				GlistaItem     *item;
+				GlistaReminder *reminder;
+				gchar          *item_text, *item_note;
+				gboolean        item_done;
+				guint64         item_id;
 				
 				gtk_tree_model_get(GL_ITEMSTM, &child_iter, 
 								   GL_COLUMN_TEXT, &item_text,
 								   GL_COLUMN_NOTE, &item_note,
-								   GL_COLUMN_DONE, &item_done, -1);
+								   GL_COLUMN_DONE, &item_done, 
+								   GL_COLUMN_REMINDER, &reminder,
+								   GL_COLUMN_ID, &item_id, -1);
 				
-				// Add new item to new parent
+				// Add new item to new parent, keeping its ID and reminder
+				glista_item_unindex(&child_iter);
 				item = glista_item_new(item_text, new_name);
+				item->id   = item_id;
 				item->done = item_done;
 				item->note = item_note; 
+				if (reminder != NULL) {
+					item->remind_at = reminder->remind_at;
+					item->repeat    = glista_reminder_get_repeat(reminder);
+				}
 				glista_list_add(item, FALSE);
 				glista_item_free(item);
+				g_free(item_text);
 
 			} while (gtk_tree_model_iter_next(GL_ITEMSTM, &child_iter));
 					
@@ -862,6 +1590,8 @@ glista_category_rename(GtkTreePath *old_path, GtkTreeIter *old_iter,
 		
 		// Free the new category path
 		gtk_tree_path_free(new_cat);
+		
+		glista_list_bulk_end(TRUE);
 	}
 }
 
@@ -876,17 +1606,22 @@ glista_category_rename(GtkTreePath *old_path, GtkTreeIter *old_iter,
 void
 glista_item_change_text(GtkTreePath *path, gchar *text)
 {
-	GtkTreeIter iter;
-	gboolean    is_cat;
+	GtkTreeIter  iter;
+	gboolean     is_cat, done;
+	gchar       *sort_key;
 	
 	if (gtk_tree_model_get_iter(GL_ITEMSTM, &iter, path)) {
-		gtk_tree_model_get(GL_ITEMSTM, &iter, GL_COLUMN_CATEGORY, &is_cat, -1);
+		gtk_tree_model_get(GL_ITEMSTM, &iter, GL_COLUMN_CATEGORY, &is_cat, 
+		                                      GL_COLUMN_DONE, &done, -1);
 		
 		if (is_cat) {
 			glista_category_rename (path, &iter, text);
 		} else {
-			gtk_tree_store_set(gl_globs->itemstore, &iter, 
-		    	               GL_COLUMN_TEXT, text, -1);
+			sort_key = glista_item_get_sort_key(text, done, FALSE);
+			glista_item_store_set(gl_globs->itemstore, &iter, 
+			                      GL_COLUMN_TEXT, text, 
+			                      GL_COLUMN_SORT_KEY, sort_key, -1);
+			g_free(sort_key);
 		}
 	}
 }
@@ -909,11 +1644,13 @@ glista_item_new(const gchar *text, const gchar *parent)
 	item = g_malloc(sizeof(GlistaItem));
 	g_assert(item != NULL);
 	
+	item->id        = 0;
 	item->done      = FALSE;
 	item->text      = (gchar *) text;
 	item->parent    = (gchar *) parent;
 	item->note      = NULL;
 	item->remind_at = -1;
+	item->repeat    = NULL;
 	
 	return item;
 }
@@ -932,59 +1669,39 @@ glista_item_free(GlistaItem *item)
 		g_free(item->note);
 	}
 	
+	g_free(item->repeat);
 	g_free(item);
 }
 
 /**
- * glista_get_category_cell_text:
- * @model: The tree model 
- * @iter:  The iterator pointing to the parent category
+ * glista_item_get_display_text:
+ * @row: The row to get the text of
  *
  * Get the text to display next to an item or a category in the tree view. Will
  * add the count of done tasks out of the total tasks in the category to the 
- * category name
+ * category name. The counts are kept in the category row, so the items in the
+ * category are not looked at, and the same buffer is reused every time.
  *
- * Returns: the category string to display
+ * Returns: the string to display, valid until the next call
  */
-static gchar *
-glista_item_get_display_text(GtkTreeModel *model, GtkTreeIter *iter)
+static const gchar*
+glista_item_get_display_text(GlistaItemRow *row)
 {
-	gboolean     is_cat, is_done;
-	gint         i, child_c, done_c;
-	gchar       *text, *newtext, *child_c_str, *done_c_str;
-	GtkTreeIter  child;
-	
-	// Get category name
-	gtk_tree_model_get(model, iter, GL_COLUMN_TEXT, &text, 
-					                GL_COLUMN_CATEGORY, &is_cat,
-					                -1);
+	static GString *display = NULL;
 	
 	// If the row is not a category, just return the text
-	if (is_cat == FALSE) {
-		return text;
+	if (row->category == FALSE) {
+		return row->text;
 	}
 	
-	// Get count / status
-	done_c = 0;
-	child_c = gtk_tree_model_iter_n_children(model, iter);
-	for (i = 0; i < child_c; i++) {
-		if (gtk_tree_model_iter_nth_child(model, &child, iter, i) == FALSE) {
-			break;
-		}
-		
-		gtk_tree_model_get(model, &child, GL_COLUMN_DONE, &is_done, -1);
-		if (is_done == TRUE) ++done_c;
+	if (display == NULL) {
+		display = g_string_sized_new(64);
 	}
 	
-	child_c_str = g_strdup_printf("%d", child_c);
-	done_c_str = g_strdup_printf("%d", done_c);
-	
-	newtext = g_strconcat(text, " (", done_c_str, "/", child_c_str, ")", NULL);
-	
-	g_free(child_c_str);
-	g_free(done_c_str);
+	g_string_printf(display, "%s (%u/%u)", row->text, row->done_count, 
+	                row->total_count);
 	
-	return newtext;
+	return display->str;
 }
 
 /**
@@ -997,7 +1714,8 @@ glista_item_get_display_text(GtkTreeModel *model, GtkTreeIter *iter)
  *
  * Callback function called whenever an item's text cell needs to be rendered. 
  * Will define the foreground color of the text - gray if the item is done (by
- * default at least), and black if it is pending.
+ * default at least), and black if it is pending. The row is read in place, 
+ * nothing is copied out of the model.
  *
  * See gtk_tree_view_column_set_cell_data_func() for more info.
  */
@@ -1006,35 +1724,28 @@ glista_item_text_cell_data_func(GtkTreeViewColumn *column,
                                 GtkCellRenderer *cell, GtkTreeModel *model,
                                 GtkTreeIter *iter, gpointer data)
 {
-	gboolean  done, category;
-	gchar    *text, *note;
-	gint      weight;
-
-	gtk_tree_model_get(model, iter, GL_COLUMN_DONE, &done, 
-					   				GL_COLUMN_CATEGORY, &category,
-									GL_COLUMN_NOTE, &note,
-					   				-1);
+	GlistaItemRow *row = GLISTA_ITEM_STORE_ROW(iter);
+	gint           weight;
 	
 	// Set color according to done / not done
-	if (done == TRUE) {
+	if (row->done == TRUE) {
 		g_object_set(cell, "foreground", GLISTA_COLOR_DONE, NULL);
 	} else {
 		g_object_set(cell, "foreground", GLISTA_COLOR_PENDING, NULL);
 	}
 	
 	// Set underline if this item has note
-	if (note != NULL) {
+	if (row->note != NULL) {
 		g_object_set(cell, "underline", PANGO_UNDERLINE_SINGLE, NULL);
 	} else {
 		g_object_set(cell, "underline", PANGO_UNDERLINE_NONE, NULL);
 	}
 	
 	// Set weight and text depending on whether this is a category or not
-	text = glista_item_get_display_text(model, iter);
-	weight = (category ? 800 : 400);
-	g_object_set(cell, "weight", weight, "text", text, NULL);
-	
-	g_free(text);
+	weight = (row->category ? 800 : 400);
+	g_object_set(cell, "weight", weight, 
+	             "text", glista_item_get_display_text(row), 
+	             NULL);
 }
 
 /**
@@ -1055,10 +1766,8 @@ glista_item_done_cell_data_func(GtkTreeViewColumn *column,
                                 GtkCellRenderer *cell, GtkTreeModel *model,
                                 GtkTreeIter *iter, gpointer data)
 {
-	gboolean is_cat;
-	
-	gtk_tree_model_get(model, iter, GL_COLUMN_CATEGORY, &is_cat, -1);
-	g_object_set(cell, "visible", ! is_cat, NULL);
+	g_object_set(cell, "visible", ! GLISTA_ITEM_STORE_ROW(iter)->category, 
+	             NULL);
 }
 
 /**
@@ -1079,11 +1788,7 @@ glista_item_info_cell_data_func(GtkTreeViewColumn *column,
                                 GtkCellRenderer *cell, GtkTreeModel *model,
                                 GtkTreeIter *iter, gpointer data)
 {
-	gpointer *reminder;
-	
-	gtk_tree_model_get(model, iter, GL_COLUMN_REMINDER, &reminder, -1);
-	
-	if (reminder != NULL) {
+	if (GLISTA_ITEM_STORE_ROW(iter)->reminder != NULL) {
 		// has reminder!
 		g_object_set(cell, "stock-id", "glista-reminder", NULL);
 	} else {
@@ -1100,7 +1805,8 @@ glista_item_info_cell_data_func(GtkTreeViewColumn *column,
  *
  * Callback sorting function for the list of items. Will put pending items 
  * first, and done items at the bottom. Secondary sorting is done 
- * alphabetically. 
+ * alphabetically. Rows are compared by their precomputed sort keys, read in
+ * place from the rows, see glista_item_get_sort_key().
  *
  * Returns: negative if row_a sorts higher, 0 if both are equal, or positive if
  * row_b sorts first.
@@ -1111,215 +1817,261 @@ gint
 glista_list_sort_func(GtkTreeModel *model, GtkTreeIter *row_a, 
                       GtkTreeIter *row_b, gpointer user_data)
 {
-	gboolean done_a, done_b, cat_a, cat_b; 
-	gint     ret;
-	
-	// Check if any of the items is a category
-	// Fetch done & category falgs for both rows
-	gtk_tree_model_get(model, row_a, GL_COLUMN_DONE, &done_a, 
-					                 GL_COLUMN_CATEGORY, &cat_a, 
-					                 -1);
-	gtk_tree_model_get(model, row_b, GL_COLUMN_DONE, &done_b, 
-					                 GL_COLUMN_CATEGORY, &cat_b, 
-					   -1);
-		
-	// Is one a category and the other is not?
-	if (cat_a == cat_b) {
+	const gchar *key_a, *key_b;
 	
-		// Is one done and the other is not?
-		if (done_a == done_b) {
-			
-			// Go on to comparing the text
-			gchar *text_a, *text_b;
-		
-			gtk_tree_model_get(model, row_a, GL_COLUMN_TEXT, &text_a, -1);
-			gtk_tree_model_get(model, row_b, GL_COLUMN_TEXT, &text_b, -1);
-			
-			if (text_a == NULL || text_b == NULL) {
-				if (text_a == NULL && text_b == NULL) {
-					ret = 0;
-				} else {
-					ret = (text_a == NULL) ? -1 : 1;
-				}
-			} else {
-				ret = g_utf8_collate(text_a, text_b);
-			}
-			
-			g_free(text_a);
-			g_free(text_b);
-
-		// If they are not equal, order the pending tasks on top
+	key_a = GLISTA_ITEM_STORE_ROW(row_a)->sort_key;
+	key_b = GLISTA_ITEM_STORE_ROW(row_b)->sort_key;
+	
+	// Rows which were just appended have no key yet
+	if (key_a == NULL || key_b == NULL) {
+		if (key_a == NULL && key_b == NULL) {
+			return 0;
 		} else {
-			ret = (done_a ? 1 : -1);
+			return (key_a == NULL) ? -1 : 1;
 		}
-		
-	} else {
-		ret = (cat_a ? -1 : 1);
 	}
 	
-	return ret;
+	return strcmp(key_a, key_b);
 }
 
 /**
- * glista_dnd_is_draggable:
- * @drag_source The drag source
- * @oath        The path in the tree of the dragged row
+ * glista_list_load_add:
+ * @item: The item to add
  *
- * Tells whether or not a row can be dragged. A row can be dragged if it is
- * not a category. If row no longer exists will return FALSE.
+ * Add a loaded item to the list. Must be called within a bulk mutation, so 
+ * that load-time inserts do not trigger a save. Loaded items are stored as
+ * they are, unless they had to get another ID.
+ */
+static void
+glista_list_load_add(GlistaItem *item)
+{
+	guint64 id;
+	
+	id = glista_list_insert(item, FALSE);
+	if (id != item->id) {
+		glista_item_changed(id, glista_storage_item_hash(item));
+	}
+	
+	load_count++;
+}
+
+/**
+ * glista_list_load_defer:
+ * @queue: The queue of deferred items to add the item to
+ * @item:  An item loaded from storage
  *
- * Returns: TRUE if row can be dragged, FALSE otherwise
+ * Defer adding an item to the list until all other items are loaded. The 
+ * loaded item is only valid until we return, so a copy is queued.
  */
-static gboolean
-glista_dnd_is_draggable(GtkTreeDragSource *drag_source, GtkTreePath *path)
+static void
+glista_list_load_defer(GQueue *queue, GlistaItem *item)
 {
-	GtkTreeIter iter;
-	gboolean    is_cat;
+	GlistaItem *copy;
 	
-	if (gtk_tree_model_get_iter(GL_ITEMSTM, &iter, path)) {
-		gtk_tree_model_get(GL_ITEMSTM, &iter, GL_COLUMN_CATEGORY, &is_cat, -1);
-		return (! is_cat);
+	copy = glista_item_new(g_strdup(item->text), g_strdup(item->parent));
+	copy->id        = item->id;
+	copy->done      = item->done;
+	copy->note      = g_strdup(item->note);
+	copy->remind_at = item->remind_at;
+	copy->repeat    = g_strdup(item->repeat);
+	
+	g_queue_push_tail(queue, copy);
+}
+
+/**
+ * glista_list_load_item_cb:
+ * @item:      An item loaded from storage
+ * @user_data: User data passed when loading started
+ *
+ * Called by the storage module for each loaded item. Open items which are not
+ * in any category are added to the list right away - categorized and done 
+ * items are deferred, so that the first screenful is shown as soon as 
+ * possible.
+ */
+static void
+glista_list_load_item_cb(GlistaItem *item, gpointer user_data)
+{
+	if (item->done) {
+		glista_list_load_defer(load_deferred_done, item);
+		
+	} else if (item->parent != NULL) {
+		glista_list_load_defer(load_deferred_cat, item);
 		
 	} else {
-		return FALSE;
+		glista_list_load_add(item);
 	}
 }
 
 /**
- * glista_dnd_drop_possible:
- * @drag_dest:     The drag destination
- * @path:          The path in the tree to check
- * @selection_data The selected data
+ * glista_list_load_run:
+ * @max_items: Maximal number of items to process
  *
- * Tells whether a drop is possible before @path, on the same level. In our
- * case, drops are always possible. 
+ * Load the next chunk of items: read items from storage, and once all items 
+ * were read add deferred items to the list.
  *
- * Returns: TRUE
+ * Returns: TRUE if there is more to load, FALSE if loading is done
  */
-static gboolean 
-glista_dnd_drop_possible(GtkTreeDragDest *drag_dest, GtkTreePath *path, 
-						 GtkSelectionData *selection_data)
+static gboolean
+glista_list_load_run(guint max_items)
 {
-	GtkTreePath *parent;
-	GtkTreeIter  iter;
-	gint         depth;
-	gboolean     can_drop = TRUE;
+	GlistaItem *item;
+	gboolean    more = TRUE;
+	guint       i;
 	
-	depth = gtk_tree_path_get_depth(path);
+	glista_list_bulk_begin();
 	
-	// Can't create 3rd level or more
-	if (depth > 2) {
-		return FALSE;
+	if (load_loader != NULL) {
+		if (! glista_storage_load_next(load_loader, glista_list_load_item_cb, 
+		                               NULL, max_items)) {
+			glista_storage_load_end(load_loader);
+			load_loader = NULL;
+		}
+		
+	} else {
+		for (i = 0; i < max_items && more; i++) {
+			if ((item = g_queue_pop_head(load_deferred_cat)) == NULL &&
+			    (item = g_queue_pop_head(load_deferred_done)) == NULL) {
+				more = FALSE;
+				
+			} else {
+				glista_list_load_add(item);
+				
+				g_free(item->text);
+				g_free(item->parent);
+				glista_item_free(item);
+			}
+		}
 	}
 	
-	// Can always drop on root level
-	if (depth < 2) {
-		return TRUE;
-	}
+	glista_list_bulk_end(FALSE);
 	
-	// If level is 2, we have to check that the parent is a category
-	parent = gtk_tree_path_copy (path);
-	if (gtk_tree_path_up(parent)) {
-		if (gtk_tree_model_get_iter(GL_ITEMSTM, &iter, parent)) {
-			gtk_tree_model_get(GL_ITEMSTM, &iter, 
-			                   GL_COLUMN_CATEGORY, &can_drop, -1);
-		}
+	return more;
+}
+
+/**
+ * glista_list_load_progress:
+ *
+ * Show loading progress in the main window title
+ */
+static void
+glista_list_load_progress()
+{
+	gchar *title;
+	
+	title = g_strdup_printf(_("%s (loading, %u items)"), load_title, 
+	                        load_count);
+	gtk_window_set_title(GTK_WINDOW(glista_get_widget("glista_main_window")), 
+	                     title);
+	g_free(title);
+}
+
+/**
+ * glista_list_load_done:
+ *
+ * Called once all items were loaded. Counts the items in each category, 
+ * restores the main window title, and saves the list if it was changed by the
+ * user while loading.
+ */
+static void
+glista_list_load_done()
+{
+	// Count, sort the list and order the reminders once, now that all items
+	// are in
+	glista_list_update_counts();
+	glista_list_sort_resume();
+	glista_reminder_catchup_delay(GLISTA_REMINDER_CATCHUP_DELAY);
+	glista_reminder_queue_thaw();
+	
+	gtk_window_set_title(GTK_WINDOW(glista_get_widget("glista_main_window")), 
+	                     load_title);
+	gtk_tree_view_expand_all(
+		GTK_TREE_VIEW(glista_get_widget("glista_item_list")));
+	
+	g_queue_free(load_deferred_cat);
+	g_queue_free(load_deferred_done);
+	g_free(load_title);
+	load_deferred_cat  = NULL;
+	load_deferred_done = NULL;
+	load_title         = NULL;
+	
+	if (load_dirty) {
+		load_dirty = FALSE;
+		glista_list_save_timeout();
 	}
-	gtk_tree_path_free(parent);
-	
-	return can_drop;
 }
 
 /**
- * glista_dnd_delete_row:
- * @drag_source: The source of the drag operation
- * @path:        The path to delete
+ * glista_list_load_idle_cb:
+ * @user_data: User data passed when idle callback was added
  *
- * Deletes a row after it has been dragged to a new location. Will also check
- * if parent category is now empty, and if so will delete it.
+ * Idle callback loading the list one chunk at a time, yielding to the main 
+ * loop between chunks.
  *
- * Returns: TRUE if the deletion succeeded, FALSE otherwise. 
+ * Returns: TRUE if there is more to load, FALSE otherwise
  */
 static gboolean
-glista_dnd_delete_row(GtkTreeDragSource *drag_source, GtkTreePath *path)
+glista_list_load_idle_cb(gpointer user_data)
 {
-	GtkTreeIter iter, parent;
-	gboolean    has_parent;
-	
-	if (gtk_tree_model_get_iter(GL_ITEMSTM, &iter, path)) {
-		// Check if this item has a parent category
-		has_parent = gtk_tree_model_iter_parent(GL_ITEMSTM, &parent, &iter);
-	
-		// Remove item
-		gtk_tree_store_remove(GL_ITEMSTS, &iter);
-	
-		// Check if parent is now empty
-		if (has_parent && 
-		    gtk_tree_model_iter_n_children(GL_ITEMSTM, &parent) < 1) {
-		
-			// Delete parent as well
-			glista_category_delete(&parent);
-		}
-		
+	if (glista_list_load_run(GLISTA_LOAD_CHUNK)) {
+		glista_list_load_progress();
 		return TRUE;
+	}
+	
+	load_tag = 0;
+	glista_list_load_done();
 	
+	return FALSE;
+}
+
+/**
+ * glista_list_load_begin:
+ *
+ * Start loading the list from storage. The first chunk is loaded right away,
+ * and the rest is loaded from an idle callback.
+ */
+static void
+glista_list_load_begin()
+{
+	// Storage returns items in the order they were saved, which is mostly
+	// sorted already, so we only sort the list once loading is done. The 
+	// same goes for restored reminders.
+	glista_list_sort_suspend();
+	glista_reminder_queue_freeze();
+	
+	load_loader        = glista_storage_load_begin();
+	load_deferred_cat  = g_queue_new();
+	load_deferred_done = g_queue_new();
+	load_count         = 0;
+	load_dirty         = FALSE;
+	load_title         = g_strdup(gtk_window_get_title(
+		GTK_WINDOW(glista_get_widget("glista_main_window"))));
+	
+	if (glista_list_load_run(GLISTA_LOAD_CHUNK)) {
+		glista_list_load_progress();
+		load_tag = g_idle_add(glista_list_load_idle_cb, NULL);
 	} else {
-		return FALSE;
+		glista_list_load_done();
 	}
 }
 
 /**
- * glista_dnd_drag_data_received:
- * @drag_dest:      The drag destination
- * @path:           The path being dragged
- * @selection_data: The selection data
+ * glista_list_load_complete:
  *
- * Wrap the orignal drop handler, triggering a sort of the tree after a drop
- * is made. 
+ * If the list is still being loaded, load the rest of it right away. Called
+ * before the list is saved for the last time.
  */
-static gboolean
-glista_dnd_drag_data_received(GtkTreeDragDest *drag_dest, GtkTreePath *path,
-							  GtkSelectionData *selection_data)
+static void
+glista_list_load_complete()
 {
-	gboolean      res;
-	GtkTreeModel *model;
-	GtkTreePath  *orig_path;
-
-	// Call origianl drop handler 
-	res = glista_dnd_old_drag_data_received(drag_dest, path, selection_data);
-	
-	// If any reminders were set, update the reminder item ref to the new row
-	if (gtk_tree_get_row_drag_data(selection_data, &model, &orig_path)) {
-		GtkTreeIter     iter;
-		GlistaReminder *reminder;
-		
-		if (gtk_tree_model_get_iter(model, &iter, orig_path)) {
-			gtk_tree_model_get(model, &iter, GL_COLUMN_REMINDER, &reminder, -1);
-			
-			if (reminder != NULL) {
-				// Free reference to old row and set reference to new one
-				gtk_tree_row_reference_free(reminder->item_ref);
-				reminder->item_ref = gtk_tree_row_reference_new(model, path);
-			}
-		}
-		
-		gtk_tree_path_free(orig_path);	
-	}
-		
-	// FIXME / HACK: The only way I found to trigger a sort is to change 
-	// the sort column and revert it back.
-		
-	if (res) {	
-		gtk_tree_sortable_set_sort_column_id(
-			GTK_TREE_SORTABLE(gl_globs->itemstore), GL_COLUMN_CATEGORY, 
-			GTK_SORT_ASCENDING);
-		
-		gtk_tree_sortable_set_sort_column_id(
-			GTK_TREE_SORTABLE(gl_globs->itemstore), GL_COLUMN_DONE, 
-			GTK_SORT_ASCENDING);
+	if (load_tag == 0) {
+		return;
 	}
 	
-	return res;
+	g_source_remove(load_tag);
+	while (glista_list_load_run(G_MAXUINT));
+	
+	load_tag = 0;
+	glista_list_load_done();
 }
 
 /**
@@ -1334,9 +2086,6 @@ glista_list_init()
 	GtkTreeViewColumn      *text_column, *done_column, *info_column;
 	GtkTreeView            *treeview;
 	GtkTreeSelection       *selection;
-	GtkTreeDragSourceIface *dnd_siface;
-	GtkTreeDragDestIface   *dnd_diface;
-	GList                  *item, *all_items = NULL;
 	
 	treeview = GTK_TREE_VIEW(glista_get_widget("glista_item_list"));
 	
@@ -1411,30 +2160,45 @@ glista_list_init()
 	g_signal_connect(selection, "changed", 
 	                 G_CALLBACK(on_list_selection_changed), NULL);
 	
-	// Set drag-and-drop interface functions
-	dnd_siface = GTK_TREE_DRAG_SOURCE_GET_IFACE(GTK_TREE_MODEL(
-		gl_globs->itemstore));
-	dnd_diface = GTK_TREE_DRAG_DEST_GET_IFACE(GTK_TREE_MODEL(
-		gl_globs->itemstore));
+	// Load data
+	glista_list_load_begin();
+}
+
+/**
+ * glista_list_get_item:
+ * @iter: Iterator pointing to an item
+ *
+ * Copy an item from the model, with all of its persistent properties
+ *
+ * Returns: A newly allocated item, to be freed with glista_list_free_items()
+ */
+static GlistaItem*
+glista_list_get_item(GtkTreeIter *iter)
+{
+	GtkTreeIter     parent;
+	GlistaItem     *item;
+	GlistaReminder *reminder;
 	
-	dnd_siface->row_draggable = glista_dnd_is_draggable;
-	dnd_siface->drag_data_delete = glista_dnd_delete_row;
-	dnd_diface->row_drop_possible = glista_dnd_drop_possible;
+	item = glista_item_new(NULL, NULL);
 	
-	// Hook into the old drop handler 
-	glista_dnd_old_drag_data_received = dnd_diface->drag_data_received;
-	dnd_diface->drag_data_received = glista_dnd_drag_data_received;
+	gtk_tree_model_get(GL_ITEMSTM, iter, 
+	                   GL_COLUMN_ID, &item->id, 
+	                   GL_COLUMN_DONE, &item->done, 
+	                   GL_COLUMN_TEXT, &item->text, 
+	                   GL_COLUMN_NOTE, &item->note, 
+	                   GL_COLUMN_REMINDER, &reminder, -1);
+	
+	if (gtk_tree_model_iter_parent(GL_ITEMSTM, &parent, iter)) {
+		gtk_tree_model_get(GL_ITEMSTM, &parent, 
+		                   GL_COLUMN_TEXT, &item->parent, -1);
+	}
 	
-	// Load data
-	glista_storage_load_all_items(&all_items);
-	for (item = all_items; item != NULL; item = item->next) {
-		glista_list_add(item->data, FALSE);
-		glista_item_free(item->data);
+	if (reminder != NULL) {
+		item->remind_at = reminder->remind_at;	
+		item->repeat    = glista_reminder_get_repeat(reminder);
 	}
-	g_list_free(all_items);
 	
-	// Expand list
-	gtk_tree_view_expand_all(treeview);
+	return item;
 }
 
 /**
@@ -1443,16 +2207,15 @@ glista_list_init()
  * @parent:    The parent node, or NULL for root
  *
  * This function will iterate over the tree model, including child items, and
- * will populate a hashtable with GlistaItem values from the model.
+ * will populate a linked list with GlistaItem values from the model. Items 
+ * are prepended to the list, so the returned list is in reverse order.
  *
  * Returns: The pointer to the first element of the list
  */
 static GList*
 glista_list_get_all_items(GList *item_list, GtkTreeIter *parent)
 {
-	GtkTreeIter     iter;
-	GlistaItem     *item;
-	GlistaReminder *reminder;
+	GtkTreeIter iter;
 	
 	if (gtk_tree_model_iter_children(GL_ITEMSTM, &iter, parent)) {
 										 
@@ -1461,24 +2224,8 @@ glista_list_get_all_items(GList *item_list, GtkTreeIter *parent)
 				item_list = glista_list_get_all_items(item_list, &iter);
 				
 			} else {
-				item = glista_item_new(NULL, NULL);
-				
-				gtk_tree_model_get(GL_ITEMSTM, &iter, 
-		                       GL_COLUMN_DONE, &item->done, 
-		                       GL_COLUMN_TEXT, &item->text, 
-		                       GL_COLUMN_NOTE, &item->note, 
-							   GL_COLUMN_REMINDER, &reminder, -1);
-				
-				if (parent != NULL) {
-					gtk_tree_model_get(GL_ITEMSTM, parent, 
-									   GL_COLUMN_TEXT, &item->parent, -1);
-				}
-				
-				if (reminder != NULL) {
-					item->remind_at = reminder->remind_at;	
-				}
-				
-				item_list = g_list_append(item_list, item);
+				item_list = g_list_prepend(item_list, 
+				                           glista_list_get_item(&iter));
 			}
 							
 		} while (gtk_tree_model_iter_next(GL_ITEMSTM, &iter));
@@ -1486,60 +2233,388 @@ glista_list_get_all_items(GList *item_list, GtkTreeIter *parent)
 	
 	return item_list;
 }
-					  
+
+/**
+ * glista_list_free_items:
+ * @items: List of items copied by glista_list_get_item()
+ *
+ * Free a list of items, including all the strings copied from the model
+ */
+static void
+glista_list_free_items(GList *items)
+{
+	GList      *node;
+	GlistaItem *item;
+	
+	for (node = items; node != NULL; node = node->next) {
+		item = (GlistaItem *) node->data;
+		g_free(item->text);
+		g_free(item->parent);
+		glista_item_free(item);
+	}
+	
+	g_list_free(items);
+}
+
+/**
+ * glista_list_save_collect:
+ * @id:         ID of a changed item
+ * @saved_hash: Content hash of the item as last saved, or 0 if it is new
+ * @job:        The save job to add the item to
+ *
+ * Add a changed item to a save job: the item as it was saved is deleted, and
+ * the item as it is now is inserted, unless it was removed from the list. 
+ * Items which were changed back to what was saved are left out.
+ */
+static void
+glista_list_save_collect(guint64 *id, guint64 *saved_hash, GlistaSaveJob *job)
+{
+	GtkTreeIter iter;
+	gboolean    is_cat = TRUE;
+	guint64     hash = 0;
+	
+	if (glista_item_get_iter(*id, &iter)) {
+		gtk_tree_model_get(GL_ITEMSTM, &iter, GL_COLUMN_CATEGORY, &is_cat,
+		                                      GL_COLUMN_HASH, &hash, -1);
+		if (is_cat) hash = 0;
+	}
+	
+	if (hash == *saved_hash) return;
+	
+	if (*saved_hash != 0) {
+		job->deleted = g_list_prepend(job->deleted, 
+		                              g_memdup(saved_hash, sizeof(guint64)));
+	}
+	
+	if (hash != 0) {
+		job->inserted = g_list_prepend(job->inserted, 
+		                               glista_list_get_item(&iter));
+	}
+}
+
+/**
+ * glista_list_save_run:
+ * @job: The save job to run
+ *
+ * Save the changes in @job, and free the copied items. Sets whether the 
+ * changes were saved, and the time it took. May be called from the writer 
+ * thread.
+ */
+static void
+glista_list_save_run(GlistaSaveJob *job)
+{
+	GTimer *timer;
+	
+	timer = g_timer_new();
+	job->saved = glista_storage_save_changes(job->deleted, job->inserted, 
+	                                         job->all_items);
+	job->duration = (guint) (g_timer_elapsed(timer, NULL) * 1000);
+	g_timer_destroy(timer);
+	
+	g_list_foreach(job->deleted, (GFunc) g_free, NULL);
+	g_list_free(job->deleted);
+	glista_list_free_items(job->inserted);
+	glista_list_free_items(job->all_items);
+}
+
+/**
+ * glista_list_save_measured:
+ * @duration: The time the last save took, in ms
+ *
+ * Adapt the save debounce window to the measured cost of saving. The window is
+ * GLISTA_SAVE_COST_FACTOR times the average save duration, so that no more 
+ * than a fraction of the idle time is spent saving, but never shorter than 
+ * GLISTA_SAVE_TIMEOUT or longer than GLISTA_SAVE_TIMEOUT_MAX.
+ */
+static void
+glista_list_save_measured(guint duration)
+{
+	save_last_duration = duration;
+	
+	// Smooth out the average so that a single slow save does not stick
+	if (save_avg_duration == 0) {
+		save_avg_duration = duration;
+	} else {
+		save_avg_duration = (save_avg_duration * 3 + duration) / 4;
+	}
+	
+	save_window = CLAMP(save_avg_duration * GLISTA_SAVE_COST_FACTOR, 
+	                    GLISTA_SAVE_TIMEOUT, GLISTA_SAVE_TIMEOUT_MAX);
+}
+
+/**
+ * glista_list_save_get_window:
+ *
+ * Get the current save debounce window, as adapted to the cost of saving. 
+ *
+ * Returns: Save debounce window in ms
+ */
+guint
+glista_list_save_get_window()
+{
+	return save_window;
+}
+
+/**
+ * glista_list_save_get_last_duration:
+ *
+ * Get the time it took to complete the last save. 
+ *
+ * Returns: Duration of the last save in ms, or 0 if nothing was saved yet
+ */
+guint
+glista_list_save_get_last_duration()
+{
+	return save_last_duration;
+}
+
+/**
+ * glista_list_save_finish:
+ * @job: The save job which was run
+ *
+ * Called in the main loop once a save job was run, and frees the job. If 
+ * saving failed, the next save writes all items. Otherwise, the save debounce
+ * window is adapted to the time saving took.
+ */
+static void
+glista_list_save_finish(GlistaSaveJob *job)
+{
+	if (! job->saved) {
+		save_full  = TRUE;
+		save_dirty = TRUE;
+		
+	} else if (! job->quit) {
+		glista_list_save_measured(job->duration);
+	}
+	
+	g_free(job);
+}
+
+/**
+ * glista_list_save_thread:
+ * @data: Data passed at thread creation time
+ *
+ * The writer thread. Takes snapshots of the list off the save queue and hands
+ * them to the storage module, so that serialization and disk I/O never happen
+ * on the main loop. Once done with a snapshot, the main loop is notified 
+ * through glista_list_save_done_cb().
+ *
+ * Returns: NULL
+ */
+static gpointer
+glista_list_save_thread(gpointer data)
+{
+	GlistaSaveJob *job;
+	gboolean       quit = FALSE;
+	
+	while (! quit) {
+		job = (GlistaSaveJob *) g_async_queue_pop(save_queue);
+		quit = job->quit;
+		
+		glista_list_save_run(job);
+		
+		if (! quit) {
+			g_idle_add(glista_list_save_done_cb, job);
+		} else {
+			g_free(job);
+		}
+	}
+	
+	// Let the main thread know we are done
+	g_mutex_lock(save_mutex);
+	save_thread_done = TRUE;
+	g_cond_signal(save_cond);
+	g_mutex_unlock(save_mutex);
+	
+	return NULL;
+}
+
+/**
+ * glista_list_save_push:
+ * @quit: Whether the writer thread should stop after this save
+ *
+ * Take a snapshot of the rows changed since the last snapshot, and push it to
+ * the writer thread's queue. Only changed rows are copied, unless the last 
+ * save failed. If the writer thread is not running, the snapshot is saved 
+ * right away. If nothing changed since the last snapshot, no snapshot is 
+ * taken, and only a @quit request is passed on.
+ */
+static void
+glista_list_save_push(gboolean quit)
+{
+	GlistaSaveJob *job;
+	
+	// Nothing changed since the last snapshot - there is nothing to save
+	if (! (save_dirty || quit)) return;
+	
+	job = g_malloc(sizeof(GlistaSaveJob));
+	job->deleted   = NULL;
+	job->inserted  = NULL;
+	job->all_items = NULL;
+	job->quit      = quit;
+	save_dirty     = FALSE;
+	
+	save_first_change.tv_sec = 0;
+	
+	if (save_changed != NULL) {
+		g_hash_table_foreach(save_changed, 
+		                     (GHFunc) glista_list_save_collect, job);
+		g_hash_table_remove_all(save_changed);
+	}
+	
+	if (save_full) {
+		job->all_items = g_list_reverse(glista_list_get_all_items(NULL, NULL));
+		save_full = FALSE;
+	}
+	
+	if (save_thread != NULL) {
+		g_async_queue_push(save_queue, job);
+		
+	} else {
+		glista_list_save_run(job);
+		glista_list_save_finish(job);
+	}
+}
+
 /**
  * glista_list_save:
  *
- * Tell the storage module to save the entire list of items. Implements a simple
- * locking mechanism. 
- * 
- * Returns: TRUE if save was successful, or FALSE if currently locked 
- * (meaning another save is in progress).
+ * Save the list. If no save is in flight, a snapshot of the changes is taken
+ * and passed on to the writer thread. If a save is already in flight, another
+ * save is marked as pending, and will start when the current one is done.
  */
-static gboolean
+static void
 glista_list_save()
 {
-	GList           *all_items = NULL;
-	static gboolean  locked = FALSE;
-
-	if (locked) {
-		return FALSE;
+	switch (save_state) {
+		case GLISTA_SAVE_IDLE:
+			if (! save_dirty) break;
+			glista_list_save_push(FALSE);
+			if (save_thread != NULL) {
+				save_state = GLISTA_SAVE_IN_FLIGHT;
+			}
+			break;
+			
+		case GLISTA_SAVE_IN_FLIGHT:
+			save_state = GLISTA_SAVE_PENDING;
+			break;
+			
+		case GLISTA_SAVE_PENDING:
+			break;
 	}
-	locked = TRUE;
+}
+
+/**
+ * glista_list_save_done_cb:
+ * @job: The save job the writer thread is done with
+ *
+ * Called in the main loop when the writer thread finished saving. If another
+ * save was requested in the meantime, it is started now.
+ *
+ * Returns: FALSE, so that the callback is not called again
+ */
+static gboolean
+glista_list_save_done_cb(gpointer job)
+{
+	glista_list_save_finish((GlistaSaveJob *) job);
 	
-	all_items = glista_list_get_all_items(all_items, NULL);
-	glista_storage_save_all_items(all_items);
-    	
-   	// Free items list
-   	while (all_items != NULL) {
-   		glista_item_free(all_items->data);
-   		all_items = all_items->next;
+	if (save_state == GLISTA_SAVE_PENDING) {
+		save_state = GLISTA_SAVE_IDLE;
+		glista_list_save();
+	} else {
+		save_state = GLISTA_SAVE_IDLE;
 	}
-	g_list_free(all_items);
 	
-	locked = FALSE;
-	return TRUE;
+	return FALSE;
 }
 
 /**
  * glista_list_save_timeout_cb: 
  * @user_data: User data passed when timeout was created
  * 
- * Called by glista_list_save_timeout() after a timeout of X ms. Will try to 
- * save the list to storage by calling glista_list_save(). If save was not 
- * successful, will run again.		return &iter;
+ * Called by glista_list_save_timeout() after a timeout of X ms. Will save the
+ * list to storage by calling glista_list_save().
  *
- * Returns: FALSE if no need to run again, TRUE otherwise.
+ * Returns: FALSE, so that the timeout is not called again
  */
 static gboolean
 glista_list_save_timeout_cb(gpointer user_data)
 {
-	if (glista_list_save()) {
+	gl_globs->save_tag = 0;
+	glista_list_save();
+	
+	return FALSE;
+}
+
+/**
+ * glista_list_save_init:
+ *
+ * Start the writer thread. If the thread cannot be started, saves will happen
+ * synchronously in the main loop.
+ */
+static void
+glista_list_save_init()
+{
+	GError *error = NULL;
+	
+	save_queue = g_async_queue_new();
+	save_mutex = g_mutex_new();
+	save_cond  = g_cond_new();
+	
+	save_thread = g_thread_create(glista_list_save_thread, NULL, TRUE, &error);
+	if (save_thread == NULL) {
+		g_warning("Unable to start writer thread, saving synchronously: %s", 
+		          error->message);
+		g_error_free(error);
+	}
+}
+
+/**
+ * glista_list_save_shutdown:
+ *
+ * Save the list one last time and stop the writer thread. Will wait for the 
+ * writer to finish for up to GLISTA_SAVE_SHUTDOWN_TIMEOUT ms.
+ *
+ * Returns: TRUE if the writer thread is done, FALSE if it may still be saving
+ */
+static gboolean
+glista_list_save_shutdown()
+{
+	GTimeVal deadline;
+	gboolean done;
+	
+	// Cancel any scheduled save - we are saving now
+	if (gl_globs->save_tag != 0) {
+		g_source_remove(gl_globs->save_tag);
 		gl_globs->save_tag = 0;
-		return FALSE;
-	} else {
+	}
+	
+	glista_list_save_push(TRUE);
+	
+	if (save_thread == NULL) {
 		return TRUE;
 	}
+	
+	g_get_current_time(&deadline);
+	g_time_val_add(&deadline, GLISTA_SAVE_SHUTDOWN_TIMEOUT * 1000);
+	
+	g_mutex_lock(save_mutex);
+	while (! save_thread_done) {
+		if (! g_cond_timed_wait(save_cond, save_mutex, &deadline)) {
+			break;
+		}
+	}
+	done = save_thread_done;
+	g_mutex_unlock(save_mutex);
+	
+	if (done) {
+		g_thread_join(save_thread);
+		save_thread = NULL;
+	} else {
+		g_warning("Timed out waiting for the list to be saved");
+	}
+	
+	return done;
 }
 
 /**
@@ -1548,17 +2623,45 @@ glista_list_save_timeout_cb(gpointer user_data)
  * Called whenever the user changes something in the data model. Will schedule 
  * an X ms timeout and call the save procedure after that time. If additional
  * save requests are recieved at that period, will postpone saving until we have
- * X ms of idle time. 
+ * X ms of idle time. X is adapted to the cost of saving, see 
+ * glista_list_save_measured(). Saving is never postponed for more than 
+ * GLISTA_SAVE_MAX_LATENCY ms after the first unsaved change.
  */
 void 
 glista_list_save_timeout()
 {
+	GTimeVal now;
+	glong    elapsed;
+	guint    delay;
+	
+	save_dirty = TRUE;
+	
+	// Never save a partially loaded list - save once loading is done
+	if (load_tag != 0) {
+		load_dirty = TRUE;
+		return;
+	}
+	
+	g_get_current_time(&now);
+	if (save_first_change.tv_sec == 0) {
+		save_first_change = now;
+	}
+	
+	// Do not let a stream of changes postpone saving forever
+	elapsed = (now.tv_sec - save_first_change.tv_sec) * 1000 + 
+	          (now.tv_usec - save_first_change.tv_usec) / 1000;
+	delay   = save_window;
+	
+	if (elapsed + (glong) delay > GLISTA_SAVE_MAX_LATENCY) {
+		delay = (guint) MAX(0, GLISTA_SAVE_MAX_LATENCY - elapsed);
+	}
+	
 	if (gl_globs->save_tag != 0) {
 		g_source_remove(gl_globs->save_tag);
 	}
 	
-	gl_globs->save_tag = g_timeout_add(GLISTA_SAVE_TIMEOUT, 
-	                                   glista_list_save_timeout_cb, NULL);
+	gl_globs->save_tag = g_timeout_add(delay, glista_list_save_timeout_cb, 
+	                                   NULL);
 }
 
 /**
@@ -1594,6 +2697,12 @@ glista_cfg_check_dir()
 	return TRUE;
 }
 
+/**
+ * Names of the reminder catch-up policies in the configuration file, in 
+ * GlistaReminderCatchup order
+ */
+static const gchar *glista_cfg_catchup_names[] = { "all", "digest", "latest" };
+
 /**
  * glista_cfg_init_load:
  * 
@@ -1602,9 +2711,10 @@ glista_cfg_check_dir()
 void
 glista_cfg_init_load()
 {
-	gchar        *cfgfile;
+	gchar        *cfgfile, *catchup;
 	GKeyFile     *keyfile;
 	GError       *error = NULL;
+	guint         i;
 	
 	// Initialize configuration stuct
 	gl_globs->config = g_malloc(sizeof(GlistaConfig));
@@ -1613,6 +2723,10 @@ glista_cfg_init_load()
 	gl_globs->config->width   = -1;
 	gl_globs->config->height  = -1;
 	gl_globs->config->visible = TRUE;
+	gl_globs->config->storage_backend = NULL;
+	gl_globs->config->reminder_batch_window = GLISTA_REMINDER_BATCH_WINDOW;
+	gl_globs->config->reminder_catchup = GLISTA_REMINDER_CATCHUP_DIGEST;
+	gl_globs->config->reminder_module = NULL;
 
 	cfgfile = g_build_filename(gl_globs->configdir, "glista.conf", NULL);
 	
@@ -1631,6 +2745,23 @@ glista_cfg_init_load()
     	                                      "glistaui", "width", NULL);
 		gl_globs->config->height = g_key_file_get_integer(keyfile, 
     	                                      "glistaui", "height", NULL);
+		gl_globs->config->storage_backend = g_key_file_get_string(keyfile,
+		                                      "storage", "backend", NULL);
+		if (g_key_file_has_key(keyfile, "reminders", "batch_window", NULL)) {
+			gl_globs->config->reminder_batch_window = g_key_file_get_integer(
+			                          keyfile, "reminders", "batch_window", NULL);
+		}
+		if ((catchup = g_key_file_get_string(keyfile, "reminders", "catchup", 
+		                                     NULL)) != NULL) {
+			for (i = 0; i < G_N_ELEMENTS(glista_cfg_catchup_names); i++) {
+				if (strcmp(catchup, glista_cfg_catchup_names[i]) == 0) {
+					gl_globs->config->reminder_catchup = i;
+				}
+			}
+			g_free(catchup);
+		}
+		gl_globs->config->reminder_module = g_key_file_get_string(keyfile,
+		                                      "reminders", "module", NULL);
 	} else {
 		if (error != NULL) {
 			fprintf(stderr, _("Error loading config file: [%d] %s\n"
@@ -1674,6 +2805,24 @@ glista_cfg_save()
 	g_key_file_set_boolean(keyfile, "glistaui", "visible", 
 						   gl_globs->config->visible);
 	
+	// Set storage backend, if not the default one
+	if (gl_globs->config->storage_backend != NULL) {
+		g_key_file_set_string(keyfile, "storage", "backend", 
+		                      gl_globs->config->storage_backend);
+	}
+	
+	// Set time window in which due reminders are delivered together
+	g_key_file_set_integer(keyfile, "reminders", "batch_window", 
+	                       gl_globs->config->reminder_batch_window);
+	g_key_file_set_string(keyfile, "reminders", "catchup", 
+	    glista_cfg_catchup_names[gl_globs->config->reminder_catchup]);
+	
+	// Set reminder module, if not the default one
+	if (gl_globs->config->reminder_module != NULL) {
+		g_key_file_set_string(keyfile, "reminders", "module", 
+		                      gl_globs->config->reminder_module);
+	}
+	
 	glista_cfg_check_dir();
 		
 	// Save configuration file
@@ -1704,6 +2853,7 @@ main(int argc, char *argv[])
 {
 	gboolean      no_tray = FALSE;
 	gboolean      minimized = FALSE;
+	gboolean      saved;
 	GError       *error = NULL;
 	GOptionEntry  entries[] = {
 		{ "no-tray", 'T', 0, G_OPTION_ARG_NONE, &no_tray, 
@@ -1765,21 +2915,25 @@ main(int argc, char *argv[])
 #endif
 
 	// Initialize item storage model
-	gl_globs->itemstore  = gtk_tree_store_new(5, 
-		G_TYPE_BOOLEAN, // Done?
-		G_TYPE_STRING,  // Text
-		G_TYPE_BOOLEAN, // Category?
-		G_TYPE_STRING,  // Note
-		G_TYPE_POINTER  // Reminder
-	);
+	gl_globs->itemstore  = glista_item_store_new();
 	
 	// Initialize categories hashtable
 	gl_globs->categories = g_hash_table_new_full(g_str_hash, g_str_equal,
-		(GDestroyNotify) g_free, (GDestroyNotify) gtk_tree_row_reference_free);
+		(GDestroyNotify) g_free, (GDestroyNotify) g_free);
+	
+	// Initialize the item index, keyed by 64 bit IDs like content hashes
+	gl_globs->items = glista_storage_hash_table_new(
+		(GDestroyNotify) gtk_tree_iter_free);
 
+	// Initialize the storage backend
+	glista_storage_init(gl_globs->config->storage_backend);
+	
 	// Initialize the item list
 	glista_list_init();
 	
+	// Start the writer thread
+	glista_list_save_init();
+	
 	// Hook up model change signals to the data save handler
 	g_signal_connect(gl_globs->itemstore, "row-changed", 
 		G_CALLBACK(on_itemstore_row_changed), NULL);
@@ -1800,8 +2954,15 @@ main(int argc, char *argv[])
 	// Close and store note if open
 	glista_note_close();
 	
-	// Save list
-	while (! glista_list_save());
+	// Finish loading the list, if still loading
+	glista_list_load_complete();
+	
+	// Save list and stop the writer thread. If the writer is still saving, 
+	// storage is left as is, as it is still in use.
+	saved = glista_list_save_shutdown();
+	if (saved) {
+		glista_storage_shutdown();
+	}
 	
 	glista_ui_shutdown();
 	glista_reminder_shutdown();
@@ -1814,9 +2975,17 @@ main(int argc, char *argv[])
 	glista_unique_unref();
 #endif
 	
+	// The writer thread may still be using the globals - exit without freeing
+	if (! saved) {
+		return 1;
+	}
+	
 	// Free globals
 	g_hash_table_destroy(gl_globs->categories);
+	g_hash_table_destroy(gl_globs->items);
 	g_free(gl_globs->configdir);
+	g_free(gl_globs->config->storage_backend);
+	g_free(gl_globs->config->reminder_module);
 	g_free(gl_globs->config);
 	g_free(gl_globs);
 
@@ -37,6 +37,8 @@
                                G_DIR_SEPARATOR_S \
                                "glista48.png"
 
+#define GLISTA_RH_DEFAULT_RESPONSE_SNOOZE 1
+
 // Declare this plugin
 GLISTA_DECLARE_PLUGIN(
 	GLISTA_PLUGIN_REMINDER, 
@@ -44,6 +46,23 @@ GLISTA_DECLARE_PLUGIN(
 	_("Gtk+ popup message dialog")
 );
 
+/**
+ * g_module_check_init:
+ * @module The module being loaded
+ * 
+ * Called by GModule when the module is loaded. Reminder dialogs may still be 
+ * shown after switching to a different reminder module, so the module is 
+ * never unloaded once it was loaded, to keep their callbacks around.
+ *
+ * Returns: NULL, so that loading the module goes on
+ */
+G_MODULE_EXPORT const gchar*
+g_module_check_init(GModule *module)
+{
+    g_module_make_resident(module);
+    return NULL;
+}
+
 /**
  * glista_remindhandler_init:
  * @error A pointer to fill with an error, if any 
@@ -73,32 +92,58 @@ glista_remindhandler_shutdown(GError **error)
 }
 
 /**
- * glista_remindhandler_remind:
- * @reminder     The reminder to handle
- * @error        A pointer to fill with an error, if any
+ * glista_rh_default_ids_free:
+ * @item_ids Array of item IDs
  * 
- * Remind the user about a task. 
+ * Free the array of item IDs bound to a reminder dialog
+ */
+static void
+glista_rh_default_ids_free(gpointer item_ids)
+{
+    g_array_free((GArray *) item_ids, TRUE);
+}
+
+/**
+ * on_reminder_dialog_response:
+ * @dialog   The reminder dialog
+ * @response The response ID
+ * @data     User data bound at signal connect time
  * 
- * Returns: TRUE on success, FALSE otherwise
+ * Snooze the reminders of the dialog if requested, and close it
  */
-G_MODULE_EXPORT gboolean
-glista_remindhandler_remind(GlistaReminder *reminder, 
-                            GError **error)
+static void
+on_reminder_dialog_response(GtkDialog *dialog, gint response, gpointer data)
+{
+    GArray *item_ids;
+    guint   i;
+    
+    if (response == GLISTA_RH_DEFAULT_RESPONSE_SNOOZE) {
+        item_ids = g_object_get_data(G_OBJECT(dialog), "glista-item-ids");
+        for (i = 0; i < item_ids->len; i++) {
+            glista_reminder_snooze(g_array_index(item_ids, guint64, i), 
+                                   GLISTA_REMINDER_SNOOZE);
+        }
+    }
+    
+    gtk_widget_destroy(GTK_WIDGET(dialog));
+}
+
+/**
+ * glista_rh_default_show:
+ * @text     The text to show in the dialog
+ * @item_ids IDs of the items reminded of, freed with the dialog
+ * 
+ * Open a reminder message dialog showing the given text, with a button to 
+ * snooze the reminders.
+ */
+static void
+glista_rh_default_show(const gchar *text, GArray *item_ids)
 {
     GtkWidget        *dialog;
     GtkWindow        *mainwindow;
-    GtkTreeIter       iter;
-    GtkTreePath      *path;
-    gchar            *item_text;
     
     mainwindow = GTK_WINDOW(glista_get_widget("glista_main_window"));
     
-    // Get the task as text
-    // TODO: Concat the category ?
-    path = gtk_tree_row_reference_get_path(reminder->item_ref);
-    gtk_tree_model_get_iter(GL_ITEMSTM, &iter, path);
-    gtk_tree_model_get(GL_ITEMSTM, &iter, GL_COLUMN_TEXT, &item_text, -1);
-    
     dialog = gtk_message_dialog_new(mainwindow, 
                                     GTK_DIALOG_DESTROY_WITH_PARENT, 
                                     GTK_MESSAGE_INFO,
@@ -106,12 +151,75 @@ glista_remindhandler_remind(GlistaReminder *reminder,
                                     _("Glista Reminder"));
                                     
     gtk_message_dialog_format_secondary_text(GTK_MESSAGE_DIALOG(dialog), 
-                                             "%s", item_text);
+                                             "%s", text);
+    
+    gtk_dialog_add_button(GTK_DIALOG(dialog), _("Snooze"), 
+                          GLISTA_RH_DEFAULT_RESPONSE_SNOOZE);
+    g_object_set_data_full(G_OBJECT(dialog), "glista-item-ids", item_ids, 
+                           glista_rh_default_ids_free);
     
-    g_signal_connect_swapped(dialog, "response", 
-                             G_CALLBACK(gtk_widget_destroy), dialog);
+    g_signal_connect(dialog, "response", 
+                     G_CALLBACK(on_reminder_dialog_response), NULL);
 
     gtk_widget_show(dialog);
+}
+
+/**
+ * glista_remindhandler_remind:
+ * @notice       The due reminder to handle
+ * @error        A pointer to fill with an error, if any
+ * 
+ * Remind the user about a task. Opens a dialog, so this is called on the 
+ * main thread.
+ * 
+ * Returns: TRUE on success, FALSE otherwise
+ */
+G_MODULE_EXPORT gboolean
+glista_remindhandler_remind(GlistaReminderNotice *notice, 
+                            GError **error)
+{
+    GArray *item_ids;
+    
+    item_ids = g_array_new(FALSE, FALSE, sizeof(guint64));
+    g_array_append_val(item_ids, notice->item_id);
+    
+    // TODO: Concat the category ?
+    glista_rh_default_show(notice->text, item_ids);
+    
+    return TRUE;
+}
+
+/**
+ * glista_remindhandler_remind_batch:
+ * @batch        The due reminders to handle
+ * @error        A pointer to fill with an error, if any
+ * 
+ * Remind the user about several tasks which are due together, using a single
+ * dialog listing one task per line.
+ * 
+ * Returns: TRUE on success, FALSE otherwise
+ */
+G_MODULE_EXPORT gboolean
+glista_remindhandler_remind_batch(GlistaReminderBatch *batch, 
+                                  GError **error)
+{
+    GlistaReminderNotice *notice;
+    GString              *text;
+    GArray               *item_ids;
+    guint                 i;
+    
+    text = g_string_new(NULL);
+    item_ids = g_array_sized_new(FALSE, FALSE, sizeof(guint64), 
+                                 batch->notices->len);
+    for (i = 0; i < batch->notices->len; i++) {
+        notice = g_ptr_array_index(batch->notices, i);
+        if (i > 0) g_string_append_c(text, '\n');
+        g_string_append(text, notice->text);
+        g_array_append_val(item_ids, notice->item_id);
+    }
+    
+    glista_rh_default_show(text->str, item_ids);
+    g_string_free(text, TRUE);
     
     return TRUE;
 }
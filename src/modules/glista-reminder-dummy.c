@@ -73,7 +73,7 @@ glista_remindhandler_shutdown(GError **error)
 
 /**
  * glista_remindhandler_remind:
- * @reminder     The reminder to handle
+ * @notice       The due reminder to handle
  * @error        A pointer to fill with an error, if any
  * 
  * Remind the user about a task. The dummy reminder simply prints out a 
@@ -82,26 +82,19 @@ glista_remindhandler_shutdown(GError **error)
  * Returns: TRUE on success, FALSE otherwise
  */
 G_MODULE_EXPORT gboolean
-glista_remindhandler_remind(GlistaReminder *reminder, 
+glista_remindhandler_remind(GlistaReminderNotice *notice, 
                             GError **error)
 {
-	GtkTreePath *path;
-	GtkTreeIter  iter;
-	gchar       *item_text, *time_str;
+	gchar       *time_str;
 	struct tm   *ltime;
 	
 	// Get reminder time into a string
-	ltime = localtime(&(reminder->remind_at));
+	ltime = localtime(&(notice->remind_at));
 	time_str = g_malloc0(sizeof(gchar[72]));
 	strftime(time_str, 70, "%x %H:%M", ltime);
 	
-	// Get the item name
-	path = gtk_tree_row_reference_get_path(reminder->item_ref);
-	gtk_tree_model_get_iter(GL_ITEMSTM, &iter, path);
-	gtk_tree_model_get(GL_ITEMSTM, &iter, GL_COLUMN_TEXT, &item_text, -1);
-	
 	// Remind!
-	g_print("It's %s - don't forget: %s\n", time_str, item_text);
+	g_print("It's %s - don't forget: %s\n", time_str, notice->text);
 	
 	// Free used memory
 	g_free(time_str);
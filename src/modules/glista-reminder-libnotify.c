@@ -42,6 +42,11 @@
 
 static void on_notification_close_clicked(NotifyNotification *nfication, 
                                           gchar *action, gpointer data);
+static void on_notification_snooze_clicked(NotifyNotification *nfication, 
+                                           gchar *action, GArray *item_ids);
+
+// Notification icon, loaded when the module is initialized
+static GdkPixbuf *icon_pb = NULL;
 
 // Declare this plugin
 GLISTA_DECLARE_PLUGIN(
@@ -50,11 +55,28 @@ GLISTA_DECLARE_PLUGIN(
 	"libnotify popup"
 );
 
+/**
+ * g_module_check_init:
+ * @module The module being loaded
+ * 
+ * Called by GModule when the module is loaded. Notifications may still be 
+ * shown after switching to a different reminder module, so the module is 
+ * never unloaded once it was loaded, to keep their callbacks around.
+ *
+ * Returns: NULL, so that loading the module goes on
+ */
+G_MODULE_EXPORT const gchar*
+g_module_check_init(GModule *module)
+{
+    g_module_make_resident(module);
+    return NULL;
+}
+
 /**
  * glista_remindhandler_init:
  * @error A pointer to fill with an error, if any 
  * 
- * Initialize the remind handler module. 
+ * Initialize the remind handler module, and load the notification icon. 
  *
  * Returns: TRUE on success, FALSE otherwise
  */
@@ -68,6 +90,11 @@ glista_remindhandler_init(GError **error)
         return FALSE;
     }
     
+    // Notifications are shown without an icon if it can't be loaded
+    if (icon_pb == NULL) {
+        icon_pb = gdk_pixbuf_new_from_file(GLISTA_RH_NOTIFY_ICON, NULL);
+    }
+    
     return TRUE;
 }
 
@@ -83,55 +110,61 @@ G_MODULE_EXPORT gboolean
 glista_remindhandler_shutdown(GError **error)
 {
     notify_uninit();
+    
+    if (icon_pb != NULL) {
+        g_object_unref(icon_pb);
+        icon_pb = NULL;
+    }
+    
     return TRUE;
 }
 
 /**
- * glista_remindhandler_remind:
- * @reminder     The reminder to handle
- * @error        A pointer to fill with an error, if any
+ * glista_rh_notify_ids_free:
+ * @item_ids Array of item IDs
  * 
- * Remind the user about a task. 
+ * Free the array of item IDs bound to the "Snooze" action
+ */
+static void
+glista_rh_notify_ids_free(gpointer item_ids)
+{
+    g_array_free((GArray *) item_ids, TRUE);
+}
+
+/**
+ * glista_rh_notify_show:
+ * @body     The notification body text
+ * @item_ids Array of the IDs of the items reminded of, freed by this function
+ * @error    A pointer to fill with an error, if any
+ * 
+ * Show a reminder notification with the given body text. The notification 
+ * is kept until it is closed, so that its "Snooze" action can be handled.
  * 
  * Returns: TRUE on success, FALSE otherwise
  */
-G_MODULE_EXPORT gboolean
-glista_remindhandler_remind(GlistaReminder *reminder, 
-                            GError **error)
+static gboolean
+glista_rh_notify_show(const gchar *body, GArray *item_ids, GError **error)
 {
-    GtkTreeIter         iter;
-    GtkTreePath        *path;
-    gchar              *item_text;
     NotifyNotification *nfication;
-    gboolean            success = TRUE;
     GError             *notify_error = NULL;
-    static GdkPixbuf   *icon_pb = NULL;
     
     // Make sure libnotify is initialized
     if (! notify_is_initted()) {
         g_set_error(error, GLISTA_REMINDER_ERROR_QUARK, 
                     GLISTA_REMINDER_ERROR_MESSAGE,
                     "libnotify interface is not initalized");
+        g_array_free(item_ids, TRUE);
         return FALSE;
     }
     
-    // Set up icon
-    if (icon_pb == NULL) {
-        icon_pb = gdk_pixbuf_new_from_file(GLISTA_RH_NOTIFY_ICON, NULL);
-    }
-        
-    // Get the task as text
-    // TODO: Concat the category ?
-    path = gtk_tree_row_reference_get_path(reminder->item_ref);
-    gtk_tree_model_get_iter(GL_ITEMSTM, &iter, path);
-    gtk_tree_model_get(GL_ITEMSTM, &iter, GL_COLUMN_TEXT, &item_text, -1);
-    
     // Create reminder
-    // TODO: Attach to systray icon?
-    nfication = notify_notification_new(GLISTA_RH_NOTIFY_TITLE, item_text, 
+    nfication = notify_notification_new(GLISTA_RH_NOTIFY_TITLE, body, 
                                         NULL, NULL);
                                         
     notify_notification_set_timeout(nfication, GLISTA_RH_NOTIFY_TIMEOUT);
+    notify_notification_add_action(nfication, "snooze", "Snooze", 
+    	(NotifyActionCallback) on_notification_snooze_clicked, item_ids, 
+    	glista_rh_notify_ids_free);
     notify_notification_add_action(nfication, "close", "Dismiss", 
     	(NotifyActionCallback) on_notification_close_clicked, NULL, NULL);
     
@@ -154,11 +187,73 @@ glista_remindhandler_remind(GlistaReminder *reminder,
                     notify_error->message);
                     
         g_error_free(notify_error);
-        success = FALSE;
+        g_object_unref(nfication);
+        return FALSE;
     }
     
-    g_object_unref(nfication);
+    // Actions are only handled while the notification is alive
+    g_signal_connect(nfication, "closed", G_CALLBACK(g_object_unref), NULL);
 
+    return TRUE;
+}
+
+/**
+ * glista_remindhandler_remind:
+ * @notice       The due reminder to handle
+ * @error        A pointer to fill with an error, if any
+ * 
+ * Remind the user about a task. libnotify is not thread safe, and its action
+ * callbacks are run by the main loop, so this is called on the main thread.
+ * 
+ * Returns: TRUE on success, FALSE otherwise
+ */
+G_MODULE_EXPORT gboolean
+glista_remindhandler_remind(GlistaReminderNotice *notice, 
+                            GError **error)
+{
+    GArray *item_ids;
+    
+    item_ids = g_array_new(FALSE, FALSE, sizeof(guint64));
+    g_array_append_val(item_ids, notice->item_id);
+    
+    // TODO: Concat the category ?
+    return glista_rh_notify_show(notice->text, item_ids, error);
+}
+
+/**
+ * glista_remindhandler_remind_batch:
+ * @batch        The due reminders to handle
+ * @error        A pointer to fill with an error, if any
+ * 
+ * Remind the user about several tasks which are due together, using a single
+ * notification listing one task per line. Called on the main thread, like 
+ * glista_remindhandler_remind().
+ * 
+ * Returns: TRUE on success, FALSE otherwise
+ */
+G_MODULE_EXPORT gboolean
+glista_remindhandler_remind_batch(GlistaReminderBatch *batch, 
+                                  GError **error)
+{
+    GlistaReminderNotice *notice;
+    GString              *body;
+    GArray               *item_ids;
+    gboolean              success;
+    guint                 i;
+    
+    body = g_string_new(NULL);
+    item_ids = g_array_sized_new(FALSE, FALSE, sizeof(guint64), 
+                                 batch->notices->len);
+    for (i = 0; i < batch->notices->len; i++) {
+        notice = g_ptr_array_index(batch->notices, i);
+        if (i > 0) g_string_append_c(body, '\n');
+        g_string_append(body, notice->text);
+        g_array_append_val(item_ids, notice->item_id);
+    }
+    
+    success = glista_rh_notify_show(body->str, item_ids, error);
+    g_string_free(body, TRUE);
+    
     return success;
 }
 
@@ -177,3 +272,26 @@ on_notification_close_clicked(NotifyNotification *nfication,
 	notify_notification_close(nfication, NULL);	
 }
                               	
+
+/**
+ * on_notification_snooze_clicked:
+ * @nfication Notification object
+ * @action    The action that was executed ("snooze")
+ * @item_ids  IDs of the items the notification reminds of
+ * 
+ * Snooze the reminders of the notification and close it. Called on the main
+ * thread.
+ */
+static void
+on_notification_snooze_clicked(NotifyNotification *nfication, 
+                               gchar *action, GArray *item_ids) 
+{
+	guint i;
+	
+	for (i = 0; i < item_ids->len; i++) {
+		glista_reminder_snooze(g_array_index(item_ids, guint64, i), 
+		                       GLISTA_REMINDER_SNOOZE);
+	}
+	
+	notify_notification_close(nfication, NULL);	
+}
@@ -0,0 +1,589 @@
+/**
+ * Glista - A simple task list management utility
+ * Copyright (C) 2008 Shahar Evron, shahar@prematureoptimization.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gmodule.h>
+#include <gtk/gtk.h>
+#include <sqlite3.h>
+
+#include "../glista.h"
+#include "../glista-plugin.h"
+#include "../glista-storage.h"
+
+/**
+ * Glista storage backend module: SQLite
+ *
+ * Stores items as rows in an SQLite database. Each save is a single
+ * transaction: a deleted item and an inserted item are paired into a single
+ * row UPDATE (so changing an item updates one row), and any remaining
+ * deleted or inserted items are deleted or inserted. Rows are looked up by
+ * an indexed content hash. If the delta holds all items, all rows are 
+ * replaced instead.
+ *
+ * When the database is created, items are imported from the XML backend. If
+ * the import fails, the new database is removed, so that it is retried on the
+ * next run.
+ * Databases created before items had IDs are migrated on open.
+ */
+
+GLISTA_DECLARE_PLUGIN(
+	GLISTA_PLUGIN_STORAGE,
+	"storage-sqlite",
+	"SQLite database"
+);
+
+#define GL_SQLITE_FILENAME "itemstore.sqlite"
+
+#define GL_SQLITE_SCHEMA \
+	"CREATE TABLE IF NOT EXISTS items (" \
+	"  id        INTEGER PRIMARY KEY," \
+	"  hash      INTEGER NOT NULL," \
+	"  done      INTEGER NOT NULL," \
+	"  remind_at INTEGER NOT NULL," \
+	"  text      TEXT NOT NULL," \
+	"  parent    TEXT," \
+	"  note      TEXT," \
+	"  item_id   INTEGER NOT NULL DEFAULT 0," \
+	"  repeat    TEXT" \
+	");" \
+	"CREATE INDEX IF NOT EXISTS items_hash ON items (hash);"
+
+#define GL_SQLITE_SCHEMA_VERSION 2
+
+#define GL_SQLITE_MIGRATE_ID \
+	"ALTER TABLE items ADD COLUMN item_id INTEGER NOT NULL DEFAULT 0"
+
+#define GL_SQLITE_MIGRATE_REPEAT \
+	"ALTER TABLE items ADD COLUMN repeat TEXT"
+
+#define GL_SQLITE_SELECT \
+	"SELECT done, remind_at, text, parent, note, item_id, repeat FROM items " \
+	"ORDER BY id"
+
+#define GL_SQLITE_INSERT \
+	"INSERT INTO items " \
+	"(hash, done, remind_at, text, parent, note, item_id, repeat) " \
+	"VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8)"
+
+#define GL_SQLITE_UPDATE \
+	"UPDATE items SET hash = ?1, done = ?2, remind_at = ?3, text = ?4, " \
+	"parent = ?5, note = ?6, item_id = ?7, repeat = ?8 " \
+	"WHERE id = (SELECT id FROM items WHERE hash = ?9 LIMIT 1)"
+
+#define GL_SQLITE_DELETE \
+	"DELETE FROM items " \
+	"WHERE id = (SELECT id FROM items WHERE hash = ?1 LIMIT 1)"
+
+#define GL_SQLITE_DELETE_ALL \
+	"DELETE FROM items"
+
+static sqlite3      *db          = NULL;
+static sqlite3_stmt *stmt_insert = NULL;
+static sqlite3_stmt *stmt_update = NULL;
+static sqlite3_stmt *stmt_delete = NULL;
+
+/**
+ * sqlite_set_error:
+ * @error   A pointer to fill with an error, if any
+ * @code    The error code
+ * @message Description of what failed
+ *
+ * Set an error, appending the last SQLite error message
+ */
+static void
+sqlite_set_error(GError **error, gint code, const gchar *message)
+{
+	g_set_error(error, GLISTA_STORAGE_ERROR_QUARK, code, "%s: %s", message,
+	            (db != NULL ? sqlite3_errmsg(db) : "no database"));
+}
+
+/**
+ * sqlite_exec:
+ * @sql   SQL statements to execute
+ * @error A pointer to fill with an error, if any
+ *
+ * Execute SQL statements which return no data
+ *
+ * Returns: TRUE on success, FALSE otherwise
+ */
+static gboolean
+sqlite_exec(const gchar *sql, GError **error)
+{
+	if (sqlite3_exec(db, sql, NULL, NULL, NULL) != SQLITE_OK) {
+		sqlite_set_error(error, GLISTA_STORAGE_ERROR_OTHER, sql);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/**
+ * sqlite_bind_item:
+ * @stmt The statement to bind the item to
+ * @item The item
+ *
+ * Bind an item's content hash and properties to parameters 1 to 8 of an
+ * INSERT or UPDATE statement
+ */
+static void
+sqlite_bind_item(sqlite3_stmt *stmt, GlistaItem *item)
+{
+	sqlite3_bind_int64(stmt, 1, (sqlite3_int64) glista_storage_item_hash(item));
+	sqlite3_bind_int(stmt, 2, (item->done ? 1 : 0));
+	sqlite3_bind_int64(stmt, 3, (sqlite3_int64) item->remind_at);
+	sqlite3_bind_text(stmt, 4, item->text, -1, SQLITE_STATIC);
+	sqlite3_bind_text(stmt, 5, item->parent, -1, SQLITE_STATIC);
+	sqlite3_bind_text(stmt, 6, item->note, -1, SQLITE_STATIC);
+	sqlite3_bind_int64(stmt, 7, (sqlite3_int64) item->id);
+	sqlite3_bind_text(stmt, 8, item->repeat, -1, SQLITE_STATIC);
+}
+
+/**
+ * sqlite_migrate:
+ * @created Whether the database was just created with the current schema
+ * @error   A pointer to fill with an error, if any
+ *
+ * Bring the schema of an existing database up to date. The schema version is
+ * kept in the database's user_version.
+ *
+ * Returns: TRUE on success, FALSE otherwise
+ */
+static gboolean
+sqlite_migrate(gboolean created, GError **error)
+{
+	sqlite3_stmt *stmt;
+	gint          version = 0;
+	gchar        *sql;
+	gboolean      success;
+
+	if (sqlite3_prepare_v2(db, "PRAGMA user_version", -1, &stmt, NULL)
+	    == SQLITE_OK) {
+		if (sqlite3_step(stmt) == SQLITE_ROW) {
+			version = sqlite3_column_int(stmt, 0);
+		}
+		sqlite3_finalize(stmt);
+	}
+
+	if (version >= GL_SQLITE_SCHEMA_VERSION) {
+		return TRUE;
+	}
+
+	if (! created) {
+		// Items stored before IDs were introduced get new IDs when loaded
+		if (version < 1 && (! sqlite_exec(GL_SQLITE_MIGRATE_ID, error))) {
+			return FALSE;
+		}
+		
+		// Items stored before recurring reminders do not repeat
+		if (version < 2 && (! sqlite_exec(GL_SQLITE_MIGRATE_REPEAT, error))) {
+			return FALSE;
+		}
+	}
+
+	sql = g_strdup_printf("PRAGMA user_version = %d", 
+	                      GL_SQLITE_SCHEMA_VERSION);
+	success = sqlite_exec(sql, error);
+	g_free(sql);
+
+	return success;
+}
+
+/**
+ * sqlite_run:
+ * @stmt The statement to run
+ *
+ * Run a statement which returns no data, and reset it for the next run
+ *
+ * Returns: TRUE on success, FALSE otherwise
+ */
+static gboolean
+sqlite_run(sqlite3_stmt *stmt)
+{
+	gint rc;
+
+	rc = sqlite3_step(stmt);
+	sqlite3_reset(stmt);
+	sqlite3_clear_bindings(stmt);
+
+	return (rc == SQLITE_DONE);
+}
+
+/**
+ * sqlite_insert:
+ * @item The item to insert
+ *
+ * Insert an item into the database
+ *
+ * Returns: TRUE on success, FALSE otherwise
+ */
+static gboolean
+sqlite_insert(GlistaItem *item)
+{
+	sqlite_bind_item(stmt_insert, item);
+	return sqlite_run(stmt_insert);
+}
+
+/**
+ * sqlite_import_cb:
+ * @item    An item loaded by the XML backend
+ * @success Pointer to a flag to clear on error
+ *
+ * Called for each item imported from the XML backend
+ */
+static void
+sqlite_import_cb(GlistaItem *item, gboolean *success)
+{
+	if (! sqlite_insert(item)) {
+		*success = FALSE;
+	}
+}
+
+/**
+ * sqlite_import:
+ * @error A pointer to fill with an error, if any
+ *
+ * Import all items stored by the XML backend into the database
+ *
+ * Returns: TRUE on success, FALSE otherwise
+ */
+static gboolean
+sqlite_import(GError **error)
+{
+	GlistaStorageBackend *xml;
+	gpointer              loader;
+	gboolean              success = TRUE;
+	GError               *load_error = NULL;
+
+	xml = glista_storage_xml_get_backend();
+	if ((loader = xml->load_begin(error)) == NULL) {
+		return FALSE;
+	}
+
+	if (! sqlite_exec("BEGIN", error)) {
+		xml->load_end(loader);
+		return FALSE;
+	}
+
+	while (xml->load_next(loader, (GlistaStorageLoadFunc) sqlite_import_cb,
+	                      &success, G_MAXUINT, &load_error));
+	xml->load_end(loader);
+
+	if (load_error != NULL) {
+		g_propagate_error(error, load_error);
+		sqlite_exec("ROLLBACK", NULL);
+		return FALSE;
+	}
+
+	if (! success) {
+		sqlite_set_error(error, GLISTA_STORAGE_ERROR_INIT,
+		                 "Unable to import items");
+		sqlite_exec("ROLLBACK", NULL);
+		return FALSE;
+	}
+
+	return sqlite_exec("COMMIT", error);
+}
+
+/**
+ * glista_storage_sqlite_shutdown:
+ * @error A pointer to fill with an error, if any
+ *
+ * Close the database
+ *
+ * Returns: TRUE on success, FALSE otherwise
+ */
+static gboolean
+glista_storage_sqlite_shutdown(GError **error)
+{
+	sqlite3_finalize(stmt_insert);
+	sqlite3_finalize(stmt_update);
+	sqlite3_finalize(stmt_delete);
+	stmt_insert = NULL;
+	stmt_update = NULL;
+	stmt_delete = NULL;
+
+	if (db != NULL) {
+		if (sqlite3_close(db) != SQLITE_OK) {
+			sqlite_set_error(error, GLISTA_STORAGE_ERROR_OTHER,
+			                 "Unable to close database");
+			return FALSE;
+		}
+
+		db = NULL;
+	}
+
+	return TRUE;
+}
+
+/**
+ * sqlite_init_failed:
+ * @db_file The database file
+ * @created Whether the database file was created by this run
+ *
+ * Close the database after opening it failed. A database file created by this
+ * run is removed, as it already has the current schema version, but may not 
+ * hold the imported items. The next run then creates and imports it again.
+ *
+ * Returns: FALSE
+ */
+static gboolean
+sqlite_init_failed(gchar *db_file, gboolean created)
+{
+	glista_storage_sqlite_shutdown(NULL);
+
+	if (created) {
+		g_unlink(db_file);
+	}
+
+	g_free(db_file);
+	return FALSE;
+}
+
+/**
+ * glista_storage_sqlite_init:
+ * @error A pointer to fill with an error, if any
+ *
+ * Open the database, creating it if needed
+ *
+ * Returns: TRUE on success, FALSE otherwise
+ */
+static gboolean
+glista_storage_sqlite_init(GError **error)
+{
+	gchar    *db_file;
+	gboolean  created;
+
+	db_file = g_build_filename(gl_globs->configdir, GL_SQLITE_FILENAME, NULL);
+	created = (! g_file_test(db_file, G_FILE_TEST_EXISTS));
+
+	if (sqlite3_open(db_file, &db) != SQLITE_OK) {
+		sqlite_set_error(error, GLISTA_STORAGE_ERROR_INIT,
+		                 "Unable to open database");
+		return sqlite_init_failed(db_file, created);
+	}
+
+	if ((! sqlite_exec(GL_SQLITE_SCHEMA, error)) ||
+	    (! sqlite_migrate(created, error))) {
+		return sqlite_init_failed(db_file, created);
+	}
+
+	if (sqlite3_prepare_v2(db, GL_SQLITE_INSERT, -1, &stmt_insert, NULL)
+	    != SQLITE_OK ||
+	    sqlite3_prepare_v2(db, GL_SQLITE_UPDATE, -1, &stmt_update, NULL)
+	    != SQLITE_OK ||
+	    sqlite3_prepare_v2(db, GL_SQLITE_DELETE, -1, &stmt_delete, NULL)
+	    != SQLITE_OK) {
+
+		sqlite_set_error(error, GLISTA_STORAGE_ERROR_INIT,
+		                 "Unable to prepare statements");
+		return sqlite_init_failed(db_file, created);
+	}
+
+	if (created && (! sqlite_import(error))) {
+		return sqlite_init_failed(db_file, created);
+	}
+
+	g_free(db_file);
+	return TRUE;
+}
+
+/**
+ * glista_storage_sqlite_load_begin:
+ * @error A pointer to fill with an error, if any
+ *
+ * Start loading items from the database
+ *
+ * Returns: a prepared statement selecting all items, used as the loader
+ */
+static gpointer
+glista_storage_sqlite_load_begin(GError **error)
+{
+	sqlite3_stmt *stmt;
+
+	if (sqlite3_prepare_v2(db, GL_SQLITE_SELECT, -1, &stmt, NULL)
+	    != SQLITE_OK) {
+
+		sqlite_set_error(error, GLISTA_STORAGE_ERROR_LOAD,
+		                 "Unable to load items");
+		return NULL;
+	}
+
+	return stmt;
+}
+
+/**
+ * glista_storage_sqlite_load_next:
+ * @loader:    The loader
+ * @func:      Function to call for each loaded item
+ * @user_data: User data to pass to @func
+ * @max_items: Maximal number of items to read
+ * @error:     A pointer to fill with an error, if any
+ *
+ * Read the next batch of up to @max_items items. Item strings point directly
+ * into the row data, which is valid until the next row is read.
+ *
+ * Returns: FALSE if all items were loaded or on error, TRUE if there are more
+ *          to read
+ */
+static gboolean
+glista_storage_sqlite_load_next(gpointer loader, GlistaStorageLoadFunc func,
+                                gpointer user_data, guint max_items,
+                                GError **error)
+{
+	sqlite3_stmt *stmt = (sqlite3_stmt *) loader;
+	GlistaItem    item;
+	guint         i;
+	gint          rc;
+
+	for (i = 0; i < max_items; i++) {
+		rc = sqlite3_step(stmt);
+
+		if (rc != SQLITE_ROW) {
+			if (rc != SQLITE_DONE) {
+				sqlite_set_error(error, GLISTA_STORAGE_ERROR_LOAD,
+				                 "Error loading items");
+			}
+			return FALSE;
+		}
+
+		item.done      = (sqlite3_column_int(stmt, 0) != 0);
+		item.remind_at = (time_t) sqlite3_column_int64(stmt, 1);
+		item.text      = (gchar *) sqlite3_column_text(stmt, 2);
+		item.parent    = (gchar *) sqlite3_column_text(stmt, 3);
+		item.note      = (gchar *) sqlite3_column_text(stmt, 4);
+		item.id        = (guint64) sqlite3_column_int64(stmt, 5);
+		item.repeat    = (gchar *) sqlite3_column_text(stmt, 6);
+
+		if (item.text != NULL) {
+			func(&item, user_data);
+		}
+	}
+
+	return TRUE;
+}
+
+/**
+ * glista_storage_sqlite_load_end:
+ * @loader: The loader to free
+ *
+ * Finalize the loader statement
+ */
+static void
+glista_storage_sqlite_load_end(gpointer loader)
+{
+	sqlite3_finalize((sqlite3_stmt *) loader);
+}
+
+/**
+ * glista_storage_sqlite_save:
+ * @delta: The changes to save
+ * @error: A pointer to fill with an error, if any
+ *
+ * Save changes in a single transaction. Each deleted item is paired with an
+ * inserted item if possible, so that changed items are updated in place.
+ *
+ * Returns: TRUE on success, FALSE otherwise
+ */
+static gboolean
+glista_storage_sqlite_save(GlistaStorageDelta *delta, GError **error)
+{
+	GList    *deleted, *inserted;
+	gboolean  success = TRUE;
+
+	if (! sqlite_exec("BEGIN", error)) {
+		return FALSE;
+	}
+
+	deleted  = delta->deleted;
+	inserted = delta->inserted;
+
+	// Replace all rows, rather than applying the changes
+	if (delta->all_items != NULL) {
+		success = sqlite_exec(GL_SQLITE_DELETE_ALL, NULL);
+
+		for (inserted = delta->all_items; success && inserted != NULL;
+		     inserted = inserted->next) {
+			success = sqlite_insert((GlistaItem *) inserted->data);
+		}
+
+		deleted  = NULL;
+		inserted = NULL;
+	}
+
+	// Update rows of deleted items with inserted items
+	while (success && deleted != NULL && inserted != NULL) {
+		sqlite_bind_item(stmt_update, (GlistaItem *) inserted->data);
+		sqlite3_bind_int64(stmt_update, 9,
+		                   (sqlite3_int64) *((guint64 *) deleted->data));
+
+		success = sqlite_run(stmt_update);
+
+		// If the deleted row is gone, insert a new one
+		if (success && sqlite3_changes(db) == 0) {
+			success = sqlite_insert((GlistaItem *) inserted->data);
+		}
+
+		deleted  = deleted->next;
+		inserted = inserted->next;
+	}
+
+	for (; success && deleted != NULL; deleted = deleted->next) {
+		sqlite3_bind_int64(stmt_delete, 1,
+		                   (sqlite3_int64) *((guint64 *) deleted->data));
+		success = sqlite_run(stmt_delete);
+	}
+
+	for (; success && inserted != NULL; inserted = inserted->next) {
+		success = sqlite_insert((GlistaItem *) inserted->data);
+	}
+
+	if (! success) {
+		sqlite_set_error(error, GLISTA_STORAGE_ERROR_SAVE,
+		                 "Unable to save items");
+		sqlite_exec("ROLLBACK", NULL);
+		return FALSE;
+	}
+
+	return sqlite_exec("COMMIT", error);
+}
+
+/**
+ * The SQLite backend function table
+ */
+static GlistaStorageBackend sqlite_backend = {
+	glista_storage_sqlite_init,
+	glista_storage_sqlite_shutdown,
+	glista_storage_sqlite_load_begin,
+	glista_storage_sqlite_load_next,
+	glista_storage_sqlite_load_end,
+	glista_storage_sqlite_save
+};
+
+/**
+ * glista_storagebackend_get:
+ *
+ * Get the storage backend implemented by this module
+ *
+ * Returns: the backend function table
+ */
+G_MODULE_EXPORT GlistaStorageBackend*
+glista_storagebackend_get()
+{
+	return &sqlite_backend;
+}